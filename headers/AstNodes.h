@@ -6,6 +6,8 @@
 #include "string"
 #include "memory"
 #include <memory>
+#include <cstdint>
+#include "Atoms.h"
 
 using namespace std;
 
@@ -21,6 +23,30 @@ enum class NodeType{
     ConditionalNode,
     IfNode,
     ForNode,
+    ObjectLiteralNode,
+    MemberNode,
+    CallNode,
+    FunctionDeclarationNode,
+    ReturnNode,
+    InvariantNode,
+    DictionaryLiteralNode,
+    ArrayLiteralNode,
+};
+
+struct Shape;
+struct StringValue;
+struct ParallelLoopPlan;
+
+enum class OperandTypes{ //set by the type inference pass when both operands are known, evaluation then skips the type checks
+    Unknown,
+    Numbers,
+    Strings
+};
+
+struct PropertyCache{
+    const Shape* shape = nullptr;
+    Shape* transition = nullptr;
+    int slot = -1;
 };
 
 struct Statement{
@@ -37,6 +63,7 @@ struct Expression : public Statement{
 struct Program : public Statement{
     Program():Statement(NodeType::ProgramNode){}
     vector<shared_ptr<Statement>> statements;
+    int invariantSlots = 0; //temporaries of the loop expressions hoisted in this program
     void print(int depth) const override{
         cout<<"\n--------------------------- Program ---------------------------";
         string indent (3*depth,' ');
@@ -51,15 +78,25 @@ struct Program : public Statement{
 
 struct NumberNode : public Expression{
     double value = 0;
+    int64_t integer = 0;
+    bool isInteger = false;
     NumberNode(double value):Expression(NodeType::NumberNode),value(value){}
+    NumberNode(int64_t integer):Expression(NodeType::NumberNode),value(double(integer)),integer(integer),isInteger(true){}
     void print(int depth) const override{
         string indent (3*depth,' ');
-        cout<<"\n"<<indent<<"NumberNode( "<<value<<" )";
+        cout<<"\n"<<indent<<"NumberNode( ";
+        if(isInteger){
+            cout<<integer;
+        }else{
+            cout<<value;
+        }
+        cout<<" )";
     }
 };
 
 struct StringNode : public Expression{
     string value = "";
+    shared_ptr<StringValue> interned; //the literal's value, created once by the parser
     StringNode(string value):Expression(NodeType::StringNode),value(value){}
     void print(int depth) const override{
         string indent (3*depth,' ');
@@ -69,8 +106,11 @@ struct StringNode : public Expression{
 
 struct IdentifierNode : public Expression{
     string value = "";
+    int slot = -1; //frame slot of a function local
+    int capture = -1; //index into the captures of the running function
+    int atom = -1;
     IdentifierNode(string value) : 
-    Expression(NodeType::IdentifierNode),value(value){};
+    Expression(NodeType::IdentifierNode),value(value),atom(atomOf(value)){};
     void print(int depth) const override{
         string indent (3*depth,' ');
         cout<<"\n"<<indent<<"IdentifierNode( "<<value<<" )"; 
@@ -81,7 +121,9 @@ struct BinaryNode : public Expression{
     shared_ptr<Expression> left;
     shared_ptr<Expression> right;
     string op = "";
-    BinaryNode(shared_ptr<Expression> left, shared_ptr<Expression> right, string op) : Expression(NodeType::BinaryNode), left(left),right(right),op(op){}
+    char opCode = 0; //first character of op, switched on during evaluation
+    OperandTypes operands = OperandTypes::Unknown;
+    BinaryNode(shared_ptr<Expression> left, shared_ptr<Expression> right, string op) : Expression(NodeType::BinaryNode), left(left),right(right),op(op),opCode(op[0]){}
     void print(int depth) const override{
         string indent (3*depth,' ');
         cout<<"\n"<<indent<<"BinaryNode( ";
@@ -96,7 +138,9 @@ struct VariableDeclarationNode : public Statement{
     bool IsConstant = false;
     string name = "";
     shared_ptr<Expression> value;
-    VariableDeclarationNode(string name, shared_ptr<Expression> value, bool cons) : Statement(NodeType::VariableDeclarationNode), name(name),value(value),IsConstant(cons){}
+    int slot = -1;
+    int atom = -1;
+    VariableDeclarationNode(string name, shared_ptr<Expression> value, bool cons) : Statement(NodeType::VariableDeclarationNode), name(name),value(value),IsConstant(cons),atom(atomOf(name)){}
     void print(int depth) const override{
         string indent (3*depth,' ');
         cout<<"\n"<<indent<<"VariableDeclaration( ' "<<name<<" '";
@@ -133,7 +177,9 @@ struct ConditionalNode : public Expression{
     shared_ptr<Expression> left;
     shared_ptr<Expression> right;
     string conditionOperator = "";
-    ConditionalNode(shared_ptr<Expression> left, shared_ptr<Expression> right, string conditionOperator) : Expression(NodeType::ConditionalNode), left(left),right(right),conditionOperator(conditionOperator){}
+    char opCode = 0;
+    OperandTypes operands = OperandTypes::Unknown;
+    ConditionalNode(shared_ptr<Expression> left, shared_ptr<Expression> right, string conditionOperator) : Expression(NodeType::ConditionalNode), left(left),right(right),conditionOperator(conditionOperator),opCode(conditionOperator[0]){}
     void print(int depth) const override{
         string indent(3*depth,' ');
         cout<<"\n"<<indent<<"ConditionalNode( ";
@@ -148,6 +194,7 @@ struct IfNode : public Statement{
     shared_ptr<Expression> condition;
     vector<shared_ptr<Statement>> ifBody;
     vector<shared_ptr<Statement>> elseBody;
+    bool usesFrame = false; //inside a function, locals live in frame slots and no scope environment is needed
     IfNode(shared_ptr<Expression> condition, vector<shared_ptr<Statement>> ifBody) : Statement(NodeType::IfNode), condition(condition),ifBody(ifBody){}
     IfNode(shared_ptr<Expression> condition, vector<shared_ptr<Statement>> ifBody, vector<shared_ptr<Statement>> elseBody) : Statement(NodeType::IfNode), condition(condition),ifBody(ifBody),elseBody(elseBody){}
     void print(int depth) const override{
@@ -163,6 +210,11 @@ struct ForNode : public Statement{
     shared_ptr<Expression> condition;
     shared_ptr<Statement> increment;
     vector<shared_ptr<Statement>> forBody;
+    bool usesFrame = false;
+    bool bodyDeclares = false; //the body declares variables of its own and needs a fresh scope per iteration
+    bool parallel = false;
+    shared_ptr<ParallelLoopPlan> plan; //filled on the first evaluation of a parallel for
+    vector<int> invariantSlots; //temporaries of the expressions hoisted out of this loop, cleared when the loop starts
     ForNode(shared_ptr<Statement> Initializer, shared_ptr<Expression> Condition, shared_ptr<Statement> Increment, vector<shared_ptr<Statement>> ForBody) : Statement(NodeType::ForNode), initializer(Initializer), condition(Condition), increment(Increment), forBody(ForBody){}
     void print(int depth) const override{
         string indent(3*depth,' ');
@@ -178,4 +230,140 @@ struct ForNode : public Statement{
     }
 };
 
-#endif
\ No newline at end of file
+struct ObjectLiteralNode : public Expression{
+    vector<pair<string, shared_ptr<Expression>>> properties;
+    Shape* shape = nullptr;
+    ObjectLiteralNode(vector<pair<string, shared_ptr<Expression>>> properties) : Expression(NodeType::ObjectLiteralNode), properties(properties){}
+    void print(int depth) const override{
+        string indent(3*depth,' ');
+        cout<<"\n"<<indent<<"ObjectLiteralNode( ";
+        for(auto &property : properties){
+            cout<<"\n"<<indent<<"  "<<property.first<<" :";
+            property.second->print(depth+2);
+        }
+        cout<<"\n"<<indent<<")";
+    }
+};
+
+struct DictionaryLiteralNode : public Expression{
+    vector<pair<string, shared_ptr<Expression>>> entries;
+    vector<size_t> hashes; //of the keys, computed by the parser
+    DictionaryLiteralNode(vector<pair<string, shared_ptr<Expression>>> entries, vector<size_t> hashes) : Expression(NodeType::DictionaryLiteralNode), entries(entries), hashes(hashes){}
+    void print(int depth) const override{
+        string indent (3*depth,' ');
+        cout<<"\n"<<indent<<"DictionaryLiteralNode( ";
+        for(auto &entry : entries){
+            cout<<"\n"<<indent<<"   "<<entry.first<<" :";
+            entry.second->print(depth+2);
+        }
+        cout<<"\n"<<indent<<")";
+    }
+};
+
+struct MemberNode : public Expression{
+    shared_ptr<Expression> object;
+    string property = "";
+    PropertyCache cache;
+    MemberNode(shared_ptr<Expression> object, string property) : Expression(NodeType::MemberNode), object(object), property(property){}
+    void print(int depth) const override{
+        string indent(3*depth,' ');
+        cout<<"\n"<<indent<<"MemberNode( ";
+        object->print(depth+1);
+        cout<<" . "<<property;
+        cout<<"\n"<<indent<<")";
+    }
+};
+
+struct CallNode : public Expression{
+    shared_ptr<Expression> callee;
+    vector<shared_ptr<Expression>> arguments;
+    CallNode(shared_ptr<Expression> callee, vector<shared_ptr<Expression>> arguments) : Expression(NodeType::CallNode), callee(callee), arguments(arguments){}
+    void print(int depth) const override{
+        string indent(3*depth,' ');
+        cout<<"\n"<<indent<<"CallNode( ";
+        callee->print(depth+1);
+        for(auto &argument : arguments){
+            argument->print(depth+2);
+        }
+        cout<<"\n"<<indent<<")";
+    }
+};
+
+struct CaptureSource{
+    bool fromSlot = true; //slot of the enclosing frame, otherwise a capture of the enclosing function
+    int index = 0;
+};
+
+struct FunctionDeclarationNode;
+
+struct LateCapture{ //capture of an earlier function of the same block that calls a function declared after it
+    const FunctionDeclarationNode* function = nullptr;
+    int slot = 0;
+    int capture = 0;
+};
+
+struct FunctionDeclarationNode : public Statement{
+    string name = "";
+    vector<string> parameters;
+    vector<shared_ptr<Statement>> body;
+    vector<CaptureSource> captures;
+    vector<LateCapture> lateCaptures; //filled with this function once it is created
+    int frameSize = 0;
+    int slot = -1;
+    int atom = -1;
+    FunctionDeclarationNode(string name, vector<string> parameters, int slot) : Statement(NodeType::FunctionDeclarationNode), name(name), parameters(parameters), slot(slot), atom(atomOf(name)){}
+    void print(int depth) const override{
+        string indent(3*depth,' ');
+        cout<<"\n"<<indent<<"FunctionDeclarationNode( "<<name<<" (";
+        for(auto &parameter : parameters){
+            cout<<" "<<parameter;
+        }
+        cout<<" )";
+        for(auto &statement : body){
+            statement->print(depth+1);
+        }
+        cout<<"\n"<<indent<<")";
+    }
+};
+
+struct ReturnNode : public Statement{
+    shared_ptr<Expression> value;
+    bool tailCall = false;
+    ReturnNode(shared_ptr<Expression> value, bool tailCall) : Statement(NodeType::ReturnNode), value(value), tailCall(tailCall){}
+    void print(int depth) const override{
+        string indent(3*depth,' ');
+        cout<<"\n"<<indent<<"ReturnNode( "<<(tailCall ? "tail call " : "");
+        if(value){
+            value->print(depth+1);
+        }
+        cout<<"\n"<<indent<<")";
+    }
+};
+
+struct ArrayLiteralNode : public Expression{
+    vector<shared_ptr<Expression>> elements;
+    ArrayLiteralNode(vector<shared_ptr<Expression>> elements) : Expression(NodeType::ArrayLiteralNode), elements(elements){}
+    void print(int depth) const override{
+        string indent (3*depth,' ');
+        cout<<"\n"<<indent<<"ArrayLiteralNode( ";
+        for(auto &element : elements){
+            element->print(depth+1);
+        }
+        cout<<"\n"<<indent<<")";
+    }
+};
+
+struct InvariantNode : public Expression{ //an expression of a loop whose inputs the loop does not write, evaluated once per run of the loop
+    shared_ptr<Expression> expression;
+    int slot = 0; //index of the interpreter's temporary that holds the value
+    InvariantNode(shared_ptr<Expression> expression, int slot) : Expression(NodeType::InvariantNode), expression(expression), slot(slot){}
+    void print(int depth) const override{
+        string indent (3*depth,' ');
+        cout<<"\n"<<indent<<"InvariantNode( "<<slot;
+        expression->print(depth+1);
+        cout<<"\n"<<indent<<")";
+    }
+};
+
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef ATOMS_H_v1
+#define ATOMS_H_v1
+
+#include "string"
+#include "deque"
+#include "unordered_map"
+#include "mutex"
+
+using namespace std;
+
+enum PredefinedAtom{ //registered first in every table, so they are the same in all of them
+    nullAtom,
+    trueAtom,
+    falseAtom
+};
+
+class AtomTable{ //every distinct identifier gets a small integer, environments are keyed by it
+    private:
+        mutex lock;
+        unordered_map<string, int> atoms;
+        deque<string> names;
+    public:
+        AtomTable(){
+            for(const char* name : {"null", "true", "false"}){
+                atomOf(name);
+            }
+        }
+
+        int atomOf(const string& name){
+            lock_guard<mutex> guard(lock);
+            auto atom = atoms.find(name);
+            if(atom != atoms.end()){
+                return atom->second;
+            }
+            names.push_back(name);
+            atoms.emplace(name, int(names.size() - 1));
+            return int(names.size() - 1);
+        }
+
+        const string& nameOf(int atom){
+            lock_guard<mutex> guard(lock);
+            return names[atom];
+        }
+
+        size_t size(){
+            lock_guard<mutex> guard(lock);
+            return names.size();
+        }
+};
+
+inline AtomTable*& activeAtomTable(){ //table of the programs run on this thread, nullptr for the one shared by all threads
+    thread_local AtomTable* table = nullptr;
+    return table;
+}
+
+inline AtomTable& atomTable(){
+    static AtomTable* shared = new AtomTable(); //never destroyed
+    AtomTable* active = activeAtomTable();
+    return active != nullptr ? *active : *shared;
+}
+
+inline int atomOf(const string& name){
+    return atomTable().atomOf(name);
+}
+
+inline const string& atomName(int atom){
+    return atomTable().nameOf(atom);
+}
+
+
+#endif
@@ -0,0 +1,618 @@
+#ifndef DAEMON_H_v1
+#define DAEMON_H_v1
+
+#include "iostream"
+#include "sstream"
+#include "fstream"
+#include "string"
+#include "vector"
+#include "deque"
+#include "thread"
+#include "mutex"
+#include "condition_variable"
+#include "unordered_map"
+#include "chrono"
+#include "cstring"
+#include "cerrno"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <unistd.h>
+#include "Parser.h"
+#include "Interpreter.h"
+#include "Natives.h"
+#include "TypeInference.h"
+#include "LoopInvariants.h"
+
+using namespace std;
+
+struct DaemonError : ScriptError{
+    DaemonError(const string& message):ScriptError("\n[[Stage]] : Daemon  [[ERROR]] : " + message + "\n"){}
+};
+
+/*
+    Messages between the daemon and its clients, each is a type byte, a 4 byte length and the payload.
+    A client sends the script as Source or Path, optionally Limits and Parameters, then Run.
+    The daemon answers with Output and Error chunks while the script runs and ends with Exit,
+    which holds the exit status and the nanoseconds the daemon spent on the job.
+*/
+enum class DaemonMessage : char{
+    Source = 'S',
+    Path = 'P',
+    Limits = 'L',
+    Parameter = 'V', //name and value separated by '='
+    Run = 'R',
+    Output = 'O',
+    Error = 'E',
+    Exit = 'X',
+};
+
+constexpr uint32_t daemonMessageLimit = 1u << 30;
+
+inline bool writeAll(int socket, const char* data, size_t size){
+    while(size > 0){
+        ssize_t written = send(socket, data, size, MSG_NOSIGNAL); //a client that went away must not kill the daemon with SIGPIPE
+        if(written < 0 && errno == EINTR){
+            continue;
+        }
+        if(written <= 0){
+            return false;
+        }
+        data += written;
+        size -= size_t(written);
+    }
+    return true;
+}
+
+inline bool readAll(int socket, char* data, size_t size){
+    while(size > 0){
+        ssize_t count = recv(socket, data, size, 0);
+        if(count < 0 && errno == EINTR){
+            continue;
+        }
+        if(count <= 0){
+            return false;
+        }
+        data += count;
+        size -= size_t(count);
+    }
+    return true;
+}
+
+inline void appendInteger(string& target, uint64_t value, int bytes){
+    for(int i = 0; i < bytes; i++){
+        target += char((value >> (8 * i)) & 0xff);
+    }
+}
+
+inline uint64_t integerAt(const string& source, size_t position, int bytes){
+    uint64_t value = 0;
+    for(int i = 0; i < bytes; i++){
+        value |= uint64_t(uint8_t(source[position + i])) << (8 * i);
+    }
+    return value;
+}
+
+inline bool writeMessage(int socket, DaemonMessage type, const string& payload){ //header and payload go out in one send
+    string message;
+    message.reserve(5 + payload.size());
+    message += char(type);
+    appendInteger(message, payload.size(), 4);
+    message += payload;
+    return writeAll(socket, message.data(), message.size());
+}
+
+inline bool readMessage(int socket, DaemonMessage& type, string& payload){
+    char header[5];
+    if(!readAll(socket, header, sizeof(header))){
+        return false;
+    }
+    type = DaemonMessage(header[0]);
+    uint32_t size = uint32_t(integerAt(string(header, sizeof(header)), 1, 4));
+    if(size > daemonMessageLimit){
+        return false;
+    }
+    payload.resize(size);
+    return readAll(socket, &payload[0], size);
+}
+
+inline string encodeLimits(const ExecutionLimits& limits){
+    string payload;
+    appendInteger(payload, limits.maxSteps, 8);
+    appendInteger(payload, limits.maxMemoryBytes, 8);
+    appendInteger(payload, limits.timeoutMs, 8);
+    appendInteger(payload, limits.maxCallDepth, 8);
+    return payload;
+}
+
+inline sockaddr_un daemonAddress(const string& socketPath){
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socketPath.size() >= sizeof(address.sun_path)){
+        throw DaemonError("Socket path '" + socketPath + "' is too long");
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    return address;
+}
+
+//print output of a job, sent in chunks as the buffer fills and at least every few milliseconds while the script prints
+class DaemonOutput : public streambuf{
+    private:
+        int socket;
+        string pending;
+        chrono::steady_clock::time_point lastSent = chrono::steady_clock::now();
+        bool connected = true;
+
+        static constexpr size_t chunkBytes = 16 * 1024;
+        static constexpr chrono::milliseconds chunkDelay{20};
+
+        void sendIfDue(){ //the job ends when its client went away, the output stream rethrows the error
+            if((pending.size() >= chunkBytes || chrono::steady_clock::now() - lastSent >= chunkDelay) && !send()){
+                throw DaemonError("The client disconnected");
+            }
+        }
+
+    protected:
+        int overflow(int character) override{
+            if(character != EOF){
+                pending += char(character);
+                sendIfDue();
+            }
+            return character;
+        }
+
+        streamsize xsputn(const char* data, streamsize count) override{
+            pending.append(data, size_t(count));
+            sendIfDue();
+            return count;
+        }
+
+        int sync() override{
+            send();
+            return 0;
+        }
+
+    public:
+        DaemonOutput(int socket):socket(socket){}
+
+        bool send(){ //false once the client disconnected
+            if(!pending.empty() && connected){
+                connected = writeMessage(socket, DaemonMessage::Output, pending);
+            }
+            pending.clear();
+            lastSent = chrono::steady_clock::now();
+            return connected;
+        }
+};
+
+/*
+    Runs scripts for clients that connect to a Unix domain socket, so short jobs do not pay for process startup.
+    The listening thread reads the job of every connection, only complete jobs are queued for a fixed number of worker threads, one job per connection.
+    A client that does not send its whole job within a few seconds is dropped, so idle connections never hold a worker.
+    Every job gets a new global environment and interpreter, nothing a script declares is seen by the next one.
+    Each worker keeps the programs it parsed, keyed by their source, so a script it ran before is not parsed again.
+    The names those programs use are in an atom table of the worker, which starts over with its cache.
+    The limits the daemon was started with are the upper bound for the limits a client asks for.
+*/
+class ScriptDaemon{
+    private:
+        string socketPath;
+        size_t workerCount;
+        ExecutionLimits defaultLimits;
+        int listener = -1;
+        vector<thread> workers;
+
+        static constexpr size_t cachedPrograms = 64; //per worker, the cache starts over when it is full
+        static constexpr size_t cachedAtoms = 1 << 16; //names a worker keeps before its cache starts over
+
+        struct ProgramCache{ //programs of one worker and the table of the names they use
+            unordered_map<string, shared_ptr<Program>> programs;
+            unique_ptr<AtomTable> atoms = make_unique<AtomTable>();
+
+            void startOver(){ //only between jobs, nothing of the previous jobs may use the old names
+                programs.clear();
+                atoms = make_unique<AtomTable>();
+                activeAtomTable() = atoms.get();
+            }
+        };
+
+        struct Job{
+            int connection = -1;
+            string source;
+            string path; //read by the worker, so a slow file does not hold up the other clients
+            ExecutionLimits limits;
+            vector<pair<string, string>> parameters;
+        };
+
+        struct Request{ //a connection whose job has not arrived completely yet
+            Job job;
+            string received; //start of a message that is not complete yet
+            chrono::steady_clock::time_point deadline;
+            bool closed = false;
+        };
+
+        static constexpr chrono::seconds requestTimeout{10}; //time a client has after connecting to send its whole job
+
+        deque<Job> jobs; //complete jobs waiting for a worker
+        mutex jobsLock;
+        condition_variable jobsAvailable;
+        bool stopping = false; //set under jobsLock, workers leave once the queued jobs are done
+
+        static uint64_t tighter(uint64_t daemonLimit, uint64_t clientLimit){ //0 is unlimited
+            if(daemonLimit == 0 || clientLimit == 0){
+                return max(daemonLimit, clientLimit);
+            }
+            return min(daemonLimit, clientLimit);
+        }
+
+        bool applyMessage(Job& job, DaemonMessage type, string payload){ //true for Run, the last message of a job
+            switch(type){
+                case DaemonMessage::Source:
+                    job.source = move(payload);
+                    return false;
+                case DaemonMessage::Path:
+                    job.path = move(payload);
+                    return false;
+                case DaemonMessage::Limits:
+                    if(payload.size() != 32){
+                        throw DaemonError("Invalid limits");
+                    }
+                    job.limits.maxSteps = tighter(defaultLimits.maxSteps, integerAt(payload, 0, 8));
+                    job.limits.maxMemoryBytes = tighter(defaultLimits.maxMemoryBytes, integerAt(payload, 8, 8));
+                    job.limits.timeoutMs = tighter(defaultLimits.timeoutMs, integerAt(payload, 16, 8));
+                    job.limits.maxCallDepth = tighter(defaultLimits.maxCallDepth, integerAt(payload, 24, 8));
+                    return false;
+                case DaemonMessage::Parameter:{
+                    size_t separator = payload.find('=');
+                    if(separator == string::npos || separator == 0){
+                        throw DaemonError("Parameter '" + payload + "' is not written as name=value");
+                    }
+                    job.parameters.emplace_back(payload.substr(0, separator), payload.substr(separator + 1));
+                    return false;
+                }
+                case DaemonMessage::Run:
+                    return true;
+                default:
+                    throw DaemonError("Unknown message from the client");
+            }
+        }
+
+        bool receive(Request& request){ //reads what the client sent so far without waiting, false when the connection failed
+            char buffer[64 * 1024];
+            for(int reads = 0; reads < 16; reads++){ //a client that sends a lot does not hold up the others
+                ssize_t count = recv(request.job.connection, buffer, sizeof(buffer), MSG_DONTWAIT);
+                if(count > 0){
+                    request.received.append(buffer, size_t(count));
+                    continue;
+                }
+                if(count == 0){
+                    request.closed = true;
+                    return true;
+                }
+                if(errno == EINTR){
+                    continue;
+                }
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            return true;
+        }
+
+        bool takeMessages(Request& request){ //true once the job arrived completely
+            size_t position = 0;
+            while(request.received.size() - position >= 5){
+                uint64_t size = integerAt(request.received, position + 1, 4);
+                if(size > daemonMessageLimit){
+                    throw DaemonError("Message from the client is too long");
+                }
+                if(request.received.size() - position - 5 < size){
+                    break;
+                }
+                DaemonMessage type = DaemonMessage(request.received[position]);
+                string payload = request.received.substr(position + 5, size);
+                position += 5 + size;
+                if(applyMessage(request.job, type, move(payload))){
+                    request.received.clear();
+                    return true;
+                }
+            }
+            request.received.erase(0, position);
+            return false;
+        }
+
+        static void refuse(int connection, const char* message){ //a job that never started, it ends with status 1
+            writeMessage(connection, DaemonMessage::Error, message);
+            string exit;
+            appendInteger(exit, 1, 1);
+            appendInteger(exit, 0, 8);
+            writeMessage(connection, DaemonMessage::Exit, exit);
+            close(connection);
+        }
+
+        void queueJob(Job job){
+            {
+                lock_guard<mutex> lock(jobsLock);
+                jobs.push_back(move(job));
+            }
+            jobsAvailable.notify_one();
+        }
+
+        shared_ptr<Program> parse(const string& source, const shared_ptr<Environment>& environment, unordered_map<string, shared_ptr<Program>>& programs){
+            auto cached = programs.find(source);
+            if(cached != programs.end()){
+                return cached->second;
+            }
+            istringstream input(source);
+            Parser parser;
+            parser.setInput(input);
+            shared_ptr<Program> program = make_shared<Program>();
+            for(shared_ptr<Statement> statement = parser.nextStatement(); statement != nullptr; statement = parser.nextStatement()){ //no token and tree listings
+                program->statements.push_back(statement);
+            }
+            TypeInference().analyze(program);
+            LoopInvariantMotion(environment).optimize(program); //the environment only holds the natives yet, they are the same for every job
+            programs.emplace(source, program);
+            return program;
+        }
+
+        void serve(Job& job, ProgramCache& cache){
+            chrono::steady_clock::time_point started = chrono::steady_clock::now();
+            int connection = job.connection;
+            DaemonOutput outputBuffer(connection);
+            ostream output(&outputBuffer);
+            output.exceptions(ios::badbit);
+            uint8_t status = 0;
+            try{
+                if(!job.path.empty()){
+                    ifstream file(job.path);
+                    if(!file){
+                        throw DaemonError("Could not open the script '" + job.path + "'");
+                    }
+                    ostringstream content;
+                    content << file.rdbuf();
+                    job.source = content.str();
+                }
+                bool cached = cache.programs.count(job.source) > 0;
+                if((!cached && cache.programs.size() >= cachedPrograms) || cache.atoms->size() > cachedAtoms){
+                    cache.startOver();
+                }
+                shared_ptr<Environment> environment = makeEnvironment();
+                environment->initEnvironment();
+                registerNativeFunctions(environment);
+                shared_ptr<Program> program = parse(job.source, environment, cache.programs); //before the parameters, the cached program must not depend on them
+                for(auto& parameter : job.parameters){ //numbers are passed as numbers, everything else as a string
+                    shared_ptr<R_Value> number = parseNumberText(parameter.second);
+                    environment->declareVariable(parameter.first, number != nullptr ? number : makeStringValue(parameter.second), true);
+                }
+                Interpreter interpreter;
+                interpreter.setLimits(job.limits);
+                interpreter.setOutput(output);
+                interpreter.run(program, environment);
+            }catch(const ScriptError& error){
+                status = 1;
+                outputBuffer.send();
+                writeMessage(connection, DaemonMessage::Error, error.what());
+            }catch(const exception& error){ //like running out of memory without a limit, only this job fails
+                status = 1;
+                outputBuffer.send();
+                writeMessage(connection, DaemonMessage::Error, string("\n[[Stage]] : Interpreting  [[ERROR]] : The script failed ---- ") + error.what() + "\n");
+            }
+            outputBuffer.send();
+            string exit;
+            appendInteger(exit, status, 1);
+            appendInteger(exit, uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count()), 8);
+            writeMessage(connection, DaemonMessage::Exit, exit);
+        }
+
+        void work(){
+            ProgramCache cache;
+            activeAtomTable() = cache.atoms.get();
+            while(true){
+                Job job;
+                {
+                    unique_lock<mutex> lock(jobsLock);
+                    jobsAvailable.wait(lock, [this]{ return !jobs.empty() || stopping; });
+                    if(jobs.empty()){
+                        return;
+                    }
+                    job = move(jobs.front());
+                    jobs.pop_front();
+                }
+                serve(job, cache);
+                close(job.connection);
+            }
+        }
+
+        void removeStaleSocket(const sockaddr_un& address){ //only a socket left behind by a daemon that was stopped, nothing else at the path
+            struct stat status;
+            if(lstat(socketPath.c_str(), &status) != 0){
+                if(errno == ENOENT){
+                    return;
+                }
+                throw DaemonError("Could not check '" + socketPath + "' : " + strerror(errno));
+            }
+            if(!S_ISSOCK(status.st_mode)){
+                throw DaemonError("'" + socketPath + "' exists and is not a socket");
+            }
+            int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+            if(probe < 0){
+                throw DaemonError(string("Could not create the socket : ") + strerror(errno));
+            }
+            int connected = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+            int error = errno;
+            close(probe);
+            if(connected == 0){
+                throw DaemonError("Another daemon is listening on '" + socketPath + "'");
+            }
+            if(error != ECONNREFUSED){
+                throw DaemonError("Could not check '" + socketPath + "' : " + strerror(error));
+            }
+            unlink(socketPath.c_str());
+        }
+
+    public:
+        ScriptDaemon(string socketPath, size_t workerCount, ExecutionLimits limits):socketPath(move(socketPath)),workerCount(max<size_t>(1, workerCount)),defaultLimits(limits){}
+
+        void run(){ //serves until the process is stopped, returns only by an error once the workers are joined
+            sockaddr_un address = daemonAddress(socketPath);
+            listener = socket(AF_UNIX, SOCK_STREAM, 0);
+            if(listener < 0){
+                throw DaemonError(string("Could not create the socket : ") + strerror(errno));
+            }
+            removeStaleSocket(address);
+            if(bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 128) != 0){
+                throw DaemonError("Could not listen on '" + socketPath + "' : " + strerror(errno));
+            }
+            for(size_t i = 0; i < workerCount; i++){
+                workers.emplace_back([this]{ work(); });
+            }
+            cerr<<"\n[[Daemon]] : Listening on "<<socketPath<<" with "<<workerCount<<" workers\n";
+            vector<Request> requests;
+            try{
+                receiveJobs(requests);
+            }catch(...){ //the workers finish their jobs and are joined before the error leaves the daemon
+                for(Request& request : requests){
+                    close(request.job.connection);
+                }
+                {
+                    lock_guard<mutex> lock(jobsLock);
+                    stopping = true;
+                }
+                jobsAvailable.notify_all();
+                for(thread& worker : workers){
+                    worker.join();
+                }
+                workers.clear();
+                close(listener);
+                throw;
+            }
+        }
+
+    private:
+        void receiveJobs(vector<Request>& requests){ //this thread reads the jobs, a worker only gets a connection once its job arrived
+            while(true){
+                vector<pollfd> descriptors(1 + requests.size());
+                descriptors[0] = {listener, POLLIN, 0};
+                chrono::steady_clock::time_point now = chrono::steady_clock::now();
+                int timeout = -1;
+                for(size_t i = 0; i < requests.size(); i++){
+                    descriptors[i + 1] = {requests[i].job.connection, POLLIN, 0};
+                    int left = int(max<int64_t>(0, chrono::duration_cast<chrono::milliseconds>(requests[i].deadline - now).count() + 1));
+                    timeout = timeout < 0 ? left : min(timeout, left);
+                }
+                if(poll(descriptors.data(), descriptors.size(), timeout) < 0){
+                    if(errno == EINTR){
+                        continue;
+                    }
+                    throw DaemonError(string("Could not wait for clients : ") + strerror(errno));
+                }
+                now = chrono::steady_clock::now();
+                for(size_t i = requests.size(); i-- > 0;){
+                    Request& request = requests[i];
+                    try{
+                        bool complete = false;
+                        if(descriptors[i + 1].revents != 0){
+                            if(!receive(request)){
+                                close(request.job.connection);
+                                requests.erase(requests.begin() + i);
+                                continue;
+                            }
+                            complete = takeMessages(request);
+                        }
+                        if(complete){
+                            queueJob(move(request.job));
+                        }else if(request.closed){
+                            close(request.job.connection);
+                        }else if(now >= request.deadline){
+                            throw DaemonError("The client did not send its job within " + to_string(requestTimeout.count()) + " seconds");
+                        }else{
+                            continue;
+                        }
+                    }catch(const DaemonError& error){
+                        refuse(request.job.connection, error.what());
+                    }
+                    requests.erase(requests.begin() + i);
+                }
+                if(descriptors[0].revents & POLLIN){
+                    int connection = accept(listener, nullptr, nullptr);
+                    if(connection < 0){
+                        if(errno == EINTR || errno == ECONNABORTED){
+                            continue;
+                        }
+                        throw DaemonError(string("Could not accept a connection : ") + strerror(errno));
+                    }
+                    Request request;
+                    request.job.connection = connection;
+                    request.job.limits = defaultLimits;
+                    request.deadline = now + requestTimeout;
+                    requests.push_back(move(request));
+                }
+            }
+        }
+};
+
+/*
+    Client side: sends one script to a daemon, writes what it prints to stdout and its errors to stderr,
+    and returns the exit status of the script.
+*/
+inline int runDaemonClient(const string& socketPath, const string& script, const ExecutionLimits& limits, const vector<string>& parameters, bool timing){
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
+    string request; //the whole job is ready before connecting, the daemon only waits a few seconds for it
+    auto add = [&](DaemonMessage type, const string& payload){
+        request += char(type);
+        appendInteger(request, payload.size(), 4);
+        request += payload;
+    };
+    if(script == "-"){
+        ostringstream source;
+        source << cin.rdbuf();
+        add(DaemonMessage::Source, source.str());
+    }else{
+        char* path = realpath(script.c_str(), nullptr); //the daemon runs in its own working directory
+        if(path == nullptr){
+            throw DaemonError("Could not find the script '" + script + "'");
+        }
+        add(DaemonMessage::Path, path);
+        free(path);
+    }
+    add(DaemonMessage::Limits, encodeLimits(limits));
+    for(auto& parameter : parameters){
+        add(DaemonMessage::Parameter, parameter);
+    }
+    add(DaemonMessage::Run, "");
+    sockaddr_un address = daemonAddress(socketPath);
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(connection < 0 || connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0){
+        throw DaemonError("Could not connect to '" + socketPath + "' : " + strerror(errno));
+    }
+    if(!writeAll(connection, request.data(), request.size())){
+        close(connection);
+        throw DaemonError("The daemon closed the connection");
+    }
+
+    DaemonMessage type;
+    string payload;
+    while(readMessage(connection, type, payload)){
+        if(type == DaemonMessage::Output){
+            cout.write(payload.data(), payload.size());
+            cout.flush();
+        }else if(type == DaemonMessage::Error){
+            cerr<<payload;
+        }else if(type == DaemonMessage::Exit && payload.size() == 9){
+            close(connection);
+            int status = int(uint8_t(payload[0]));
+            if(timing){
+                double daemonMs = double(integerAt(payload, 1, 8)) / 1e6;
+                double roundTripMs = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+                cerr<<"\n[[Daemon]] : Exit status "<<status<<" ---- Job : "<<daemonMs<<" ms ---- Round trip : "<<roundTripMs<<" ms\n";
+            }
+            return status;
+        }
+    }
+    close(connection);
+    throw DaemonError("The daemon closed the connection before the script finished");
+}
+
+
+#endif
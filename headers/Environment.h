@@ -8,6 +8,8 @@
 #include "memory"
 #include "unordered_map"
 #include "set"
+#include "unordered_set"
+#include "Atoms.h"
 #include "Values.h"
 
 using namespace std;
@@ -15,10 +17,10 @@ using namespace std;
 class Environment;
 void setupScope(shared_ptr<Environment> env) ;
 
-class Environment:public std::enable_shared_from_this<Environment>{
+class Environment:public std::enable_shared_from_this<Environment>,public Traceable{
     private:
-        unordered_map<string, shared_ptr<R_Value>> variables;
-        set<string> constantVariablesNames;
+        unordered_map<int, shared_ptr<R_Value>> variables; //keyed by the atom of the variable name
+        unordered_set<int> constantVariables;
         shared_ptr<Environment> parentEnvironment;
 
         void initGlobalEnvironment(){
@@ -27,56 +29,129 @@ class Environment:public std::enable_shared_from_this<Environment>{
 
     public:
 
-        Environment(shared_ptr<Environment> parentEnv= nullptr ): parentEnvironment(parentEnv),variables(),constantVariablesNames(){}
+        Environment(shared_ptr<Environment> parentEnv= nullptr ): variables(),constantVariables(),parentEnvironment(parentEnv){}
 
         void initEnvironment(){
             initGlobalEnvironment();
         }
 
-        shared_ptr<R_Value> declareVariable(const string& varName, shared_ptr<R_Value> value, bool isConst=false){
-            if(variables.find(varName) != variables.end()){
-                cerr<<"[[Stage]] : Environment  [[ERROR]] : Variable with name '" << varName << "' already declared.";
-                exit(1);
+        shared_ptr<R_Value> declareVariable(int atom, shared_ptr<R_Value> value, bool isConst=false){
+            if(!variables.emplace(atom, value).second){
+                runtimeError("[[Stage]] : Environment  [[ERROR]] : Variable with name '", atomName(atom), "' already declared.");
             }
-            variables[varName] = value;
             if(isConst){
-                constantVariablesNames.insert(varName);
+                constantVariables.insert(atom);
             }
             return value;
         }
 
-        shared_ptr<R_Value> assignVariable(const string& varName, shared_ptr<R_Value> value){
-            shared_ptr<Environment> env = resolve(varName);
-            if(env->constantVariablesNames.find(varName)!= env->constantVariablesNames.end()){
-                cerr<<"[[Stage]] : Environment  [[ERROR]] : Variable with name '" << varName << "' is constant and cannot be assigned.";
-                exit(1);
+        shared_ptr<R_Value> declareVariable(const string& varName, shared_ptr<R_Value> value, bool isConst=false){
+            return declareVariable(atomOf(varName), value, isConst);
+        }
+
+        shared_ptr<R_Value> defineNativeFunction(const string& functionName, int arity, NativeFunction function){
+            return declareVariable(functionName, make_shared<NativeFunctionValue>(functionName, arity, function), true);
+        }
+
+        shared_ptr<R_Value> assignVariable(int atom, shared_ptr<R_Value> value){
+            Environment* env = findScope(atom);
+            if(!env->constantVariables.empty() && env->constantVariables.count(atom) > 0){
+                runtimeError("[[Stage]] : Environment  [[ERROR]] : Variable with name '", atomName(atom), "' is constant and cannot be assigned.");
             } 
-            env->variables[varName] = value;
+            env->variables[atom] = value;
             return value;
         }
 
-        shared_ptr<R_Value> lookupVariable(string varname) {
-            shared_ptr<Environment> env = resolve(varname);
-            return env->variables[varname];
+        shared_ptr<R_Value> assignVariable(const string& varName, shared_ptr<R_Value> value){
+            return assignVariable(atomOf(varName), value);
+        }
+
+        const shared_ptr<R_Value>& lookupVariable(int atom) {
+            for(Environment* env = this; env != nullptr; env = env->parentEnvironment.get()){
+                auto variable = env->variables.find(atom);
+                if(variable != env->variables.end()){
+                    return variable->second;
+                }
+            }
+            return findScope(atom)->variables[atom];
+        }
+
+        shared_ptr<R_Value> lookupVariable(const string& varname) {
+            return lookupVariable(atomOf(varname));
         }
 
-        shared_ptr<Environment> resolve(string varname) {
-            if(variables.find(varname) != variables.end()) {
-                return shared_from_this();
+        shared_ptr<R_Value> findVariable(const string& varname) const{ //like lookupVariable, but nullptr for undefined names
+            int atom = atomOf(varname);
+            for(const Environment* env = this; env != nullptr; env = env->parentEnvironment.get()){
+                auto variable = env->variables.find(atom);
+                if(variable != env->variables.end()){
+                    return variable->second;
+                }
             }
-            if(parentEnvironment == nullptr) {
-                cerr << "\n[[Stage]] : Environment  [[ERROR]] : Variable not defined ---- Variable : " << varname << "\n";
-                exit(1);
+            return nullptr;
+        }
+
+        bool isConstant(const string& varname) const{
+            int atom = atomOf(varname);
+            for(const Environment* env = this; env != nullptr; env = env->parentEnvironment.get()){
+                if(env->variables.find(atom) != env->variables.end()){
+                    return env->constantVariables.count(atom) > 0;
+                }
             }
-            return parentEnvironment->resolve(varname);
+            return false;
+        }
+
+        shared_ptr<Environment> resolve(const string& varname) {
+            return findScope(atomOf(varname))->shared_from_this();
+        }
+
+        Environment* findScope(int atom) {
+            for(Environment* env = this; env != nullptr; env = env->parentEnvironment.get()){
+                if(env->variables.find(atom) != env->variables.end()){
+                    return env;
+                }
+            }
+            runtimeError("\n[[Stage]] : Environment  [[ERROR]] : Variable not defined ---- Variable : ", atomName(atom), "\n");
+        }
+
+        template<class Visit>
+        void forEachVariable(Visit visit) const{ //variables of this scope only, sorted by name
+            vector<pair<const string*, int>> names;
+            for(auto& variable : variables){
+                names.emplace_back(&atomName(variable.first), variable.first);
+            }
+            sort(names.begin(), names.end(), [](const pair<const string*, int>& left, const pair<const string*, int>& right){
+                return *left.first < *right.first;
+            });
+            for(auto& name : names){
+                visit(*name.first, variables.at(name.second), constantVariables.count(name.second) > 0);
+            }
+        }
+
+        void traceReferences(GcVisitor& visitor) const override{
+            visitor.visit(parentEnvironment.get());
+            for(auto& variable : variables){
+                visitor.visit(variable.second.get());
+            }
+        }
+
+        void clearReferences() override{
+            variables.clear();
+            parentEnvironment = nullptr;
         }
 
 };
 
+inline shared_ptr<Environment> makeEnvironment(shared_ptr<Environment> parentEnv = nullptr){
+    shared_ptr<Environment> environment = make_shared<Environment>(parentEnv);
+    garbageCollector().track(environment.get(), environment, environment.get());
+    return environment;
+}
+
 inline void setupScope(shared_ptr<Environment> environment){
-    environment->declareVariable("null", makeNullValue(), true);
-    environment->declareVariable("true", makeBoolValue(true), true);  
-    environment->declareVariable("false", makeBoolValue(false), true);
+    environment->declareVariable(nullAtom, makeNullValue(), true);
+    environment->declareVariable(trueAtom, makeBoolValue(true), true);  
+    environment->declareVariable(falseAtom, makeBoolValue(false), true);
 }
 
 
@@ -0,0 +1,96 @@
+#ifndef EXECUTION_LIMITS_H_v1
+#define EXECUTION_LIMITS_H_v1
+
+#include "string"
+#include "memory"
+#include "atomic"
+#include "stdexcept"
+#include "cstdint"
+#include "sstream"
+
+using namespace std;
+
+struct ScriptError : runtime_error{
+    ScriptError(const string& message):runtime_error(message){}
+};
+
+struct RuntimeError : ScriptError{ //a running script failed, the program embedding the interpreter decides whether that ends it
+    RuntimeError(const string& message):ScriptError(message){}
+};
+
+template<typename... Parts>
+[[noreturn]] void runtimeError(const Parts&... parts){ //the parts are written like to cerr
+    ostringstream message;
+    (message << ... << parts);
+    throw RuntimeError(message.str());
+}
+
+struct ExecutionLimitExceeded : ScriptError{
+    ExecutionLimitExceeded(const string& message):ScriptError("\n[[Stage]] : Interpreting  [[ERROR]] : Execution limit exceeded ---- " + message + "\n"){}
+};
+
+struct ExecutionLimits{ //0 means unlimited
+    uint64_t maxSteps = 0;
+    uint64_t maxMemoryBytes = 0;
+    uint64_t timeoutMs = 0;
+    uint64_t maxCallDepth = 0; //nested calls of script functions, the stack of the thread is always checked
+};
+
+struct MemoryBudget{
+    atomic<int64_t> bytesInUse{0};
+    int64_t limit = 0;
+    MemoryBudget(int64_t limit):limit(limit){}
+    void charge(int64_t bytes){
+        int64_t inUse = bytesInUse.fetch_add(bytes, memory_order_relaxed) + bytes;
+        if(limit > 0 && inUse > limit){
+            bytesInUse.fetch_sub(bytes, memory_order_relaxed);
+            throw ExecutionLimitExceeded("memory limit of " + to_string(limit) + " bytes");
+        }
+    }
+    void release(int64_t bytes){
+        bytesInUse.fetch_sub(bytes, memory_order_relaxed);
+    }
+};
+
+inline shared_ptr<MemoryBudget>& activeMemoryBudget(){ //budget of the script running on this thread, values created by it are charged to it
+    thread_local shared_ptr<MemoryBudget> budget;
+    return budget;
+}
+
+inline void reserveMemory(int64_t bytes){ //checks an allocation against the budget of this thread before it is made, the value holding it charges it afterwards
+    MemoryBudget* budget = activeMemoryBudget().get();
+    if(budget != nullptr){
+        budget->charge(bytes);
+        budget->release(bytes);
+    }
+}
+
+struct MemoryCharge{ //the part of a value's size that is charged to the budget that was active when it was created
+    shared_ptr<MemoryBudget> budget;
+    int64_t bytes = 0;
+    MemoryCharge(){}
+    MemoryCharge(const MemoryCharge&) = delete;
+    MemoryCharge& operator=(const MemoryCharge&) = delete;
+    void resize(int64_t newBytes){
+        if(budget == nullptr){
+            budget = activeMemoryBudget();
+            if(budget == nullptr){
+                return;
+            }
+        }
+        if(newBytes > bytes){
+            budget->charge(newBytes - bytes);
+        }else{
+            budget->release(bytes - newBytes);
+        }
+        bytes = newBytes;
+    }
+    ~MemoryCharge(){
+        if(budget != nullptr){
+            budget->release(bytes);
+        }
+    }
+};
+
+
+#endif
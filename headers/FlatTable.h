@@ -0,0 +1,217 @@
+#ifndef FLAT_TABLE_H_v1
+#define FLAT_TABLE_H_v1
+
+#include "string"
+#include "vector"
+#include <cstdint>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+/*
+    Open addressing hash map from strings to Value.
+    The entries are kept densely in insertion order, so they can be walked by position, and the table
+    only holds their indices. Every table slot has a control byte: empty, deleted, or the low 7 bits of
+    the hash of the key stored there. A lookup loads a group of 16 control bytes, compares all of them
+    against the hash bits at once and only looks at entries whose bits match.
+    Keys of up to 15 characters are stored inside the entry by std::string, the full hash is kept next
+    to the key so growing the table never hashes a key again.
+*/
+template<typename Value>
+class FlatStringMap{
+    public:
+        struct Entry{
+            size_t hash;
+            string key;
+            Value value;
+        };
+
+    private:
+        static constexpr int8_t emptyControl = -128;
+        static constexpr int8_t deletedControl = -2; //full slots have a control byte from 0 to 127
+        static constexpr size_t groupSize = 16;
+        static constexpr size_t notFound = SIZE_MAX;
+
+        vector<int8_t> control;
+        vector<uint32_t> slots; //index into entries for every full control byte
+        vector<Entry> entries;
+        size_t deleted = 0;
+        size_t keyBytes = 0; //key characters stored outside of the entries
+
+        static int8_t hashBits(size_t hash){
+            return int8_t(hash & 0x7f);
+        }
+
+        static uint32_t match(const int8_t* group, int8_t bits){ //one bit per control byte equal to bits
+#if defined(__SSE2__)
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+            return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(bits))));
+#else
+            uint32_t mask = 0;
+            for(size_t i = 0; i < groupSize; i++){
+                mask |= uint32_t(group[i] == bits) << i;
+            }
+            return mask;
+#endif
+        }
+
+        static uint32_t matchFree(const int8_t* group){ //empty and deleted control bytes are the negative ones
+#if defined(__SSE2__)
+            return uint32_t(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+            uint32_t mask = 0;
+            for(size_t i = 0; i < groupSize; i++){
+                mask |= uint32_t(group[i] < 0) << i;
+            }
+            return mask;
+#endif
+        }
+
+        size_t groupCount() const{
+            return control.size() / groupSize;
+        }
+
+        //groups are probed in triangular order, which visits every group once because their number is a power of two
+        size_t findSlot(const string& key, size_t hash) const{
+            size_t groups = groupCount();
+            size_t group = (hash >> 7) & (groups - 1);
+            for(size_t probe = 1; probe <= groups && groups > 0; probe++){
+                const int8_t* bytes = control.data() + group * groupSize;
+                for(uint32_t candidates = match(bytes, hashBits(hash)); candidates != 0; candidates &= candidates - 1){
+                    size_t slot = group * groupSize + __builtin_ctz(candidates);
+                    const Entry& entry = entries[slots[slot]];
+                    if(entry.hash == hash && entry.key == key){
+                        return slot;
+                    }
+                }
+                if(match(bytes, emptyControl) != 0){
+                    return notFound;
+                }
+                group = (group + probe) & (groups - 1);
+            }
+            return notFound;
+        }
+
+        void place(uint32_t index){
+            size_t hash = entries[index].hash;
+            size_t groups = groupCount();
+            size_t group = (hash >> 7) & (groups - 1);
+            for(size_t probe = 1; ; probe++){
+                uint32_t free = matchFree(control.data() + group * groupSize);
+                if(free != 0){
+                    size_t slot = group * groupSize + __builtin_ctz(free);
+                    if(control[slot] == deletedControl){
+                        deleted--;
+                    }
+                    control[slot] = hashBits(hash);
+                    slots[slot] = index;
+                    return;
+                }
+                group = (group + probe) & (groups - 1);
+            }
+        }
+
+        void rehash(size_t capacity){
+            control.assign(capacity, emptyControl);
+            slots.assign(capacity, 0);
+            deleted = 0;
+            for(uint32_t i = 0; i < entries.size(); i++){
+                place(i);
+            }
+        }
+
+        void reserveOne(){ //keeps at most 7/8 of the slots full or deleted
+            if((entries.size() + deleted + 1) * 8 <= control.size() * 7){
+                return;
+            }
+            size_t capacity = max<size_t>(control.size(), groupSize);
+            while((entries.size() + 1) * 8 > capacity * 7 / 2){ //half full after growing, so deletions alone do not rehash often
+                capacity *= 2;
+            }
+            rehash(capacity);
+        }
+
+        static size_t heapBytes(const string& key){
+            return key.capacity() > 15 ? key.capacity() + 1 : 0;
+        }
+
+    public:
+        Value* find(const string& key, size_t hash){
+            size_t slot = findSlot(key, hash);
+            return slot == notFound ? nullptr : &entries[slots[slot]].value;
+        }
+
+        bool contains(const string& key, size_t hash) const{
+            return findSlot(key, hash) != notFound;
+        }
+
+        bool set(const string& key, size_t hash, Value value){ //true when the key was added
+            size_t slot = findSlot(key, hash);
+            if(slot != notFound){
+                entries[slots[slot]].value = move(value);
+                return false;
+            }
+            reserveOne();
+            entries.push_back({hash, key, move(value)});
+            keyBytes += heapBytes(entries.back().key);
+            place(uint32_t(entries.size() - 1));
+            return true;
+        }
+
+        bool erase(const string& key, size_t hash){ //the last entry takes the place of the removed one
+            size_t slot = findSlot(key, hash);
+            if(slot == notFound){
+                return false;
+            }
+            uint32_t index = slots[slot];
+            //a group that still has an empty byte was never full, so no probe continued past it
+            const int8_t* group = control.data() + slot / groupSize * groupSize;
+            if(match(group, emptyControl) != 0){
+                control[slot] = emptyControl;
+            }else{
+                control[slot] = deletedControl;
+                deleted++;
+            }
+            keyBytes -= heapBytes(entries[index].key);
+            uint32_t last = uint32_t(entries.size() - 1);
+            if(index != last){
+                slots[findSlot(entries[last].key, entries[last].hash)] = index;
+                entries[index] = move(entries[last]);
+            }
+            entries.pop_back();
+            return true;
+        }
+
+        size_t size() const{
+            return entries.size();
+        }
+
+        const Entry& at(size_t position) const{
+            return entries[position];
+        }
+
+        Value& valueAt(size_t position){
+            return entries[position].value;
+        }
+
+        const vector<Entry>& all() const{
+            return entries;
+        }
+
+        void clear(){
+            entries.clear();
+            control.clear();
+            slots.clear();
+            deleted = 0;
+            keyBytes = 0;
+        }
+
+        size_t memoryBytes() const{
+            return control.capacity() + slots.capacity() * sizeof(uint32_t) + entries.capacity() * sizeof(Entry) + keyBytes;
+        }
+};
+
+
+#endif
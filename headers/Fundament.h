@@ -4,28 +4,114 @@
 #include "Reader.h"
 #include "Parser.h"
 #include "Interpreter.h"
+#include "Natives.h"
+#include "TypeInference.h"
+#include "LoopInvariants.h"
+#include "Snapshot.h"
+#include "GreenThreads.h"
+#include "Daemon.h"
 
 class Fundament{
     private:
     public:
-        Fundament(string filename){
-            shared_ptr<Environment> environment = make_shared<Environment>();
+        Fundament(string filename, ExecutionLimits limits = ExecutionLimits(), bool streaming = false, string loadSnapshotFile = "", string writeSnapshotFile = ""){
+            shared_ptr<Environment> environment = makeEnvironment();
             Reader reader;
             Parser parser;
             Program program;
             Interpreter interpreter;
+            TypeInference typeInference;
+            LoopInvariantMotion loopInvariants(environment);
+            interpreter.setLimits(limits);
 
             environment->initEnvironment();
-
-            program=parser.produceAST(reader.readFile(filename));
-            program.print(1); 
+            registerNativeFunctions(environment);
 
             shared_ptr<R_Value> lastResult = make_shared<NullValue>(); 
-            lastResult = interpreter.evaluate(make_shared<Program>(program),environment);
+            try{
+                if(!loadSnapshotFile.empty()){ //globals of a prelude that ran earlier, instead of running it again
+                    loadSnapshot(loadSnapshotFile, environment);
+                }
+                if(streaming){ //each top-level statement is evaluated and released before the next one is parsed
+                    ifstream file;
+                    if(filename != "-"){
+                        file.open(filename);
+                    }
+                    parser.setInput(filename == "-" ? cin : file);
+                    lastResult = interpreter.runStream([&]{
+                        shared_ptr<Statement> statement = parser.nextStatement();
+                        if(statement != nullptr){
+                            typeInference.analyze(statement);
+                            loopInvariants.optimize(statement);
+                        }
+                        return statement;
+                    }, environment);
+                }else{
+                    program=parser.produceAST(reader.readFile(filename));
+                    program.print(1); 
+                    shared_ptr<Program> programNode = make_shared<Program>(program);
+                    typeInference.analyze(programNode);
+                    loopInvariants.optimize(programNode);
+                    lastResult = interpreter.run(programNode,environment);
+                }
+                if(!writeSnapshotFile.empty()){
+                    writeSnapshot(writeSnapshotFile, *environment);
+                }
+            }catch(const ScriptError& error){
+                cerr<<error.what();
+                exit(1);
+            }
 
             cout<<"\n--------------------------- Values ---------------------------\n";
             lastResult->print();
             cout<<"\n\n--------------------------------------------------------------\n";  
+            cout<<"\n---------------------- Garbage Collector ----------------------\n";
+            garbageCollector().print();
+            cout<<"\n\n--------------------------------------------------------------\n";
+        }
+
+        Fundament(const vector<string>& filenames, ExecutionLimits limits, size_t osThreads, size_t stackBytes){ //every script runs in its own green thread with its own environment
+            GreenScheduler scheduler(osThreads, stackBytes);
+            vector<shared_ptr<R_Value>> results(filenames.size());
+            for(size_t i = 0; i < filenames.size(); i++){
+                shared_ptr<Program> program;
+                try{
+                    ifstream file(filenames[i]);
+                    Parser parser;
+                    parser.setInput(file);
+                    program = make_shared<Program>();
+                    for(shared_ptr<Statement> statement = parser.nextStatement(); statement != nullptr; statement = parser.nextStatement()){ //no token and tree listings, they would interleave
+                        program->statements.push_back(statement);
+                    }
+                    TypeInference().analyze(program);
+                }catch(const ScriptError& error){
+                    cerr<<"\n[[Script]] : "<<filenames[i]<<error.what();
+                    continue;
+                }
+                scheduler.spawn([&, i, program]{ //the environment is created on the OS thread the script runs on, its heap belongs to that thread
+                    shared_ptr<Environment> environment = makeEnvironment();
+                    environment->initEnvironment();
+                    registerNativeFunctions(environment);
+                    LoopInvariantMotion(environment).optimize(program);
+                    Interpreter interpreter;
+                    interpreter.setLimits(limits);
+                    try{
+                        results[i] = interpreter.run(program, environment);
+                    }catch(const ScriptError& error){
+                        cerr<<"\n[[Script]] : "<<filenames[i]<<error.what();
+                    }
+                });
+            }
+            scheduler.run();
+
+            cout<<"\n--------------------------- Values ---------------------------\n";
+            for(size_t i = 0; i < filenames.size(); i++){
+                if(results[i] != nullptr){
+                    cout<<"\n "<<filenames[i]<<" :";
+                    results[i]->print();
+                }
+            }
+            cout<<"\n\n--------------------------------------------------------------\n";
         }
 };
 
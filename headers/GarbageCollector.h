@@ -0,0 +1,163 @@
+#ifndef GARBAGE_COLLECTOR_H_v1
+#define GARBAGE_COLLECTOR_H_v1
+
+#include "iostream"
+#include "memory"
+#include "unordered_map"
+#include "vector"
+#include "chrono"
+
+using namespace std;
+
+struct GcVisitor{
+    virtual ~GcVisitor() = default;
+    virtual void visit(const void* object) = 0;
+};
+
+struct Traceable{ //values and environments that can hold references to each other and thereby form cycles
+    virtual ~Traceable() = default;
+    virtual void traceReferences(GcVisitor& visitor) const = 0;
+    virtual void clearReferences() = 0;
+};
+
+struct GcStatistics{
+    size_t collections = 0;
+    size_t trackedObjects = 0;
+    size_t freedObjects = 0;
+    double totalPauseMs = 0;
+    double maxPauseMs = 0;
+};
+
+/*
+    Cycle collector for the reference counted heap.
+    Every container is tracked by a weak handle. A collection subtracts the references the tracked
+    containers hold to each other from their strong counts, whatever is left over is held from outside
+    (environments in use, the interpreter stack, locals of the evaluator) and is the root set.
+    Containers not reachable from those roots only keep each other alive and get their references cleared.
+*/
+class GarbageCollector{
+    private:
+        struct Entry{
+            weak_ptr<void> handle;
+            Traceable* object = nullptr;
+            long references = 0;
+            bool reachable = false;
+        };
+
+        struct SubtractVisitor:GcVisitor{
+            unordered_map<const void*, Entry>& entries;
+            size_t references = 0;
+            SubtractVisitor(unordered_map<const void*, Entry>& entries):entries(entries){}
+            void visit(const void* object) override{
+                references++;
+                auto entry = entries.find(object);
+                if(entry != entries.end()){
+                    entry->second.references--;
+                }
+            }
+        };
+
+        struct MarkVisitor:GcVisitor{
+            unordered_map<const void*, Entry>& entries;
+            vector<Entry*>& worklist;
+            MarkVisitor(unordered_map<const void*, Entry>& entries, vector<Entry*>& worklist):entries(entries),worklist(worklist){}
+            void visit(const void* object) override{
+                auto entry = entries.find(object);
+                if(entry != entries.end() && !entry->second.reachable){
+                    entry->second.reachable = true;
+                    worklist.push_back(&entry->second);
+                }
+            }
+        };
+
+        unordered_map<const void*, Entry> entries;
+        size_t allocationsSinceCollection = 0;
+        size_t threshold = 1000;
+        GcStatistics statistics;
+
+    public:
+        void track(const void* key, const shared_ptr<void>& handle, Traceable* object){
+            entries[key] = {handle, object, 0, false};
+            if(++allocationsSinceCollection >= threshold){
+                collect();
+            }
+        }
+
+        void collect(){
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for(auto entry = entries.begin(); entry != entries.end();){
+                if(entry->second.handle.expired()){
+                    entry = entries.erase(entry);
+                    continue;
+                }
+                entry->second.references = entry->second.handle.use_count();
+                entry->second.reachable = false;
+                entry++;
+            }
+
+            SubtractVisitor subtract(entries);
+            for(auto& entry : entries){
+                entry.second.object->traceReferences(subtract);
+            }
+
+            vector<Entry*> worklist;
+            for(auto& entry : entries){
+                if(entry.second.references > 0){
+                    entry.second.reachable = true;
+                    worklist.push_back(&entry.second);
+                }
+            }
+            MarkVisitor mark(entries, worklist);
+            while(!worklist.empty()){
+                Entry* entry = worklist.back();
+                worklist.pop_back();
+                entry->object->traceReferences(mark);
+            }
+
+            vector<shared_ptr<void>> garbage; //keeps every unreachable container alive until all of them are cleared
+            vector<Traceable*> unreachable;
+            for(auto entry = entries.begin(); entry != entries.end();){
+                if(entry->second.reachable){
+                    entry++;
+                    continue;
+                }
+                garbage.push_back(entry->second.handle.lock());
+                unreachable.push_back(entry->second.object);
+                entry = entries.erase(entry);
+            }
+            for(Traceable* object : unreachable){
+                object->clearReferences();
+            }
+            statistics.freedObjects += garbage.size();
+            garbage.clear();
+
+            allocationsSinceCollection = 0;
+            threshold = max<size_t>({1000, 2 * entries.size(), subtract.references / 8}); //a collection costs a visit per reference, big tables are not traced again after every few allocations
+            double pauseMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            statistics.collections++;
+            statistics.totalPauseMs += pauseMs;
+            statistics.maxPauseMs = max(statistics.maxPauseMs, pauseMs);
+        }
+
+        GcStatistics getStatistics(){
+            statistics.trackedObjects = entries.size();
+            return statistics;
+        }
+
+        void print(){
+            GcStatistics current = getStatistics();
+            cout<<"\n Collections : "<<current.collections;
+            cout<<"\n Tracked objects : "<<current.trackedObjects;
+            cout<<"\n Freed objects : "<<current.freedObjects;
+            cout<<"\n Total pause : "<<current.totalPauseMs<<" ms";
+            cout<<"\n Longest pause : "<<current.maxPauseMs<<" ms";
+        }
+};
+
+inline GarbageCollector& garbageCollector(){ //one heap per thread, collections never touch another thread's containers
+    thread_local GarbageCollector collector;
+    return collector;
+}
+
+
+#endif
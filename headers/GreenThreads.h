@@ -0,0 +1,237 @@
+#ifndef GREEN_THREADS_H_v1
+#define GREEN_THREADS_H_v1
+
+#include "vector"
+#include "deque"
+#include "memory"
+#include "functional"
+#include "thread"
+#include "chrono"
+#include "algorithm"
+#include "exception"
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "ExecutionLimits.h"
+
+using namespace std;
+
+/*
+    Stackful coroutines for running many scripts on a few OS threads.
+    Every green thread gets its own mmap'd stack, pages are only committed once they are touched,
+    so a suspended script costs the part of its stack it actually used plus its heap.
+    A green thread stays on the OS thread it was spawned on, the garbage collector and the
+    memory budget of a script are per OS thread and must not migrate with it.
+    Scripts give up the OS thread at loop back-edges, after print and in blocking natives like sleep.
+*/
+
+constexpr size_t greenStackBytes = 512 * 1024;
+constexpr size_t minimumGreenStackBytes = 128 * 1024; //twice the reserve script calls leave free, see stackLimit
+constexpr int greenBackEdgesPerYield = 256; //loop iterations a script runs before it lets the next one run
+
+class GreenWorker;
+
+struct GreenThread{
+    ucontext_t context;
+    ucontext_t* scheduler = nullptr;
+    char* stack = nullptr;
+    size_t stackBytes = 0;
+    function<void()> body;
+    exception_ptr error;
+    bool finished = false;
+    bool sleeping = false;
+    chrono::steady_clock::time_point wakeAt;
+    int backEdgesUntilYield = greenBackEdgesPerYield;
+
+    GreenThread(function<void()> body, size_t stackBytes):stackBytes(stackBytes),body(move(body)){
+        void* memory = mmap(nullptr, stackBytes + pageSize(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if(memory == MAP_FAILED){
+            throw bad_alloc();
+        }
+        stack = static_cast<char*>(memory);
+        mprotect(stack, pageSize(), PROT_NONE); //guard page, an overflowing script faults instead of overwriting memory
+    }
+    GreenThread(const GreenThread&) = delete;
+    GreenThread& operator=(const GreenThread&) = delete;
+    ~GreenThread(){
+        munmap(stack, stackBytes + pageSize());
+    }
+
+    static size_t pageSize(){
+        static const size_t size = size_t(sysconf(_SC_PAGESIZE));
+        return size;
+    }
+};
+
+inline GreenThread*& currentGreenThread(){ //nullptr outside of green threads
+    thread_local GreenThread* current = nullptr;
+    return current;
+}
+
+constexpr size_t stackReserveBytes = 64 * 1024; //kept free below the deepest script call, for natives and error handling
+
+inline const char* stackLimit(){ //lowest address script calls may reach on this thread, nullptr when it is unknown
+    GreenThread* thread = currentGreenThread();
+    if(thread != nullptr){
+        return thread->stack + GreenThread::pageSize() + stackReserveBytes;
+    }
+    thread_local const char* limit = []() -> const char*{
+        pthread_attr_t attributes;
+        void* lowest = nullptr;
+        size_t size = 0;
+        if(pthread_getattr_np(pthread_self(), &attributes) != 0){
+            return nullptr;
+        }
+        pthread_attr_getstack(&attributes, &lowest, &size);
+        pthread_attr_destroy(&attributes);
+        return lowest == nullptr || size <= 2 * stackReserveBytes ? nullptr : static_cast<const char*>(lowest) + stackReserveBytes;
+    }();
+    return limit;
+}
+
+inline void greenYield(){ //lets the other scripts of this OS thread run, does nothing outside of green threads
+    GreenThread* thread = currentGreenThread();
+    if(thread == nullptr){
+        return;
+    }
+    thread->backEdgesUntilYield = greenBackEdgesPerYield;
+    shared_ptr<MemoryBudget> budget = activeMemoryBudget();
+    swapcontext(&thread->context, thread->scheduler);
+    activeMemoryBudget() = budget;
+}
+
+inline void greenBackEdge(){
+    GreenThread* thread = currentGreenThread();
+    if(thread != nullptr && --thread->backEdgesUntilYield <= 0){
+        greenYield();
+    }
+}
+
+inline void greenSleep(double milliseconds){ //blocking call for natives, only the calling script waits
+    chrono::steady_clock::time_point wakeAt = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(milliseconds));
+    GreenThread* thread = currentGreenThread();
+    if(thread == nullptr){
+        this_thread::sleep_until(wakeAt);
+        return;
+    }
+    thread->sleeping = true;
+    thread->wakeAt = wakeAt;
+    greenYield();
+}
+
+class GreenWorker{ //runs the green threads of one OS thread round robin
+    private:
+        ucontext_t context;
+        deque<unique_ptr<GreenThread>> runnable;
+        vector<unique_ptr<GreenThread>> sleeping; //heap, earliest wakeAt on top
+        exception_ptr firstError;
+
+        static bool wakesLater(const unique_ptr<GreenThread>& left, const unique_ptr<GreenThread>& right){
+            return left->wakeAt > right->wakeAt;
+        }
+
+        static void start(){
+            GreenThread* thread = currentGreenThread();
+            try{
+                thread->body();
+            }catch(...){
+                thread->error = current_exception();
+            }
+            thread->finished = true;
+        } //returns to the scheduler through uc_link
+
+        void wakeSleepers(){
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            while(!sleeping.empty() && sleeping.front()->wakeAt <= now){
+                pop_heap(sleeping.begin(), sleeping.end(), wakesLater);
+                sleeping.back()->sleeping = false;
+                runnable.push_back(move(sleeping.back()));
+                sleeping.pop_back();
+            }
+        }
+
+    public:
+        void spawn(function<void()> body, size_t stackBytes){
+            unique_ptr<GreenThread> thread = make_unique<GreenThread>(move(body), stackBytes);
+            getcontext(&thread->context);
+            thread->context.uc_stack.ss_sp = thread->stack + GreenThread::pageSize();
+            thread->context.uc_stack.ss_size = stackBytes;
+            thread->context.uc_link = &context;
+            thread->scheduler = &context;
+            makecontext(&thread->context, start, 0);
+            runnable.push_back(move(thread));
+        }
+
+        void run(){
+            while(!runnable.empty() || !sleeping.empty()){
+                if(runnable.empty()){
+                    this_thread::sleep_until(sleeping.front()->wakeAt);
+                }
+                wakeSleepers();
+                if(runnable.empty()){
+                    continue;
+                }
+                unique_ptr<GreenThread> thread = move(runnable.front());
+                runnable.pop_front();
+                currentGreenThread() = thread.get();
+                activeMemoryBudget() = nullptr;
+                swapcontext(&context, &thread->context);
+                currentGreenThread() = nullptr;
+                activeMemoryBudget() = nullptr;
+                if(thread->finished){
+                    if(thread->error && !firstError){
+                        firstError = thread->error;
+                    }
+                }else if(thread->sleeping){
+                    sleeping.push_back(move(thread));
+                    push_heap(sleeping.begin(), sleeping.end(), wakesLater);
+                }else{
+                    runnable.push_back(move(thread));
+                }
+            }
+        }
+
+        exception_ptr error() const{
+            return firstError;
+        }
+};
+
+class GreenScheduler{
+    private:
+        vector<unique_ptr<GreenWorker>> workers;
+        size_t stackBytes;
+        size_t nextWorker = 0;
+    public:
+        GreenScheduler(size_t threadCount = 1, size_t stackBytes = greenStackBytes){ //stacks are rounded up to whole pages and at least minimumGreenStackBytes
+            size_t page = GreenThread::pageSize();
+            this->stackBytes = (max(stackBytes, minimumGreenStackBytes) + page - 1) / page * page;
+            for(size_t i = 0; i < max<size_t>(threadCount, 1); i++){
+                workers.push_back(make_unique<GreenWorker>());
+            }
+        }
+
+        void spawn(function<void()> body){ //green threads are spread over the OS threads round robin
+            workers[nextWorker]->spawn(move(body), stackBytes);
+            nextWorker = (nextWorker + 1) % workers.size();
+        }
+
+        void run(){ //until every green thread finished, rethrows the first exception a green thread did not catch
+            vector<thread> threads;
+            for(size_t i = 1; i < workers.size(); i++){
+                threads.emplace_back([this, i]{ workers[i]->run(); });
+            }
+            workers[0]->run();
+            for(auto& osThread : threads){
+                osThread.join();
+            }
+            for(auto& worker : workers){
+                if(worker->error()){
+                    rethrow_exception(worker->error());
+                }
+            }
+        }
+};
+
+
+#endif
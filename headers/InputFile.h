@@ -0,0 +1,192 @@
+#ifndef INPUT_FILE_H_v1
+#define INPUT_FILE_H_v1
+
+#include "string"
+#include "vector"
+#include "memory"
+#include "cstring"
+#include "cerrno"
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Values.h"
+
+using namespace std;
+
+/*
+    Data file a script reads record by record, a record is a line without its line break.
+    Regular files are memory-mapped and read front to back, pipes and standard input are read in blocks.
+    Lines and fields are handed out as views into the mapping or the block, which they keep alive,
+    so scanning a file copies no text and only allocates the string values the script asks for.
+*/
+class InputFile{
+    private:
+        struct Mapping{
+            void* data = nullptr;
+            size_t size = 0;
+            ~Mapping(){
+                munmap(data, size);
+            }
+        };
+
+        static constexpr size_t blockSize = 1 << 20; //bytes read from a pipe at once
+
+        int descriptor = -1;
+        shared_ptr<const void> owner; //mapping or current block
+        const char* data = nullptr;
+        size_t size = 0;
+        size_t position = 0;
+        char* block = nullptr; //current block, bytes past size are free and only written by the next read
+        size_t capacity = 0;
+        size_t searched = 0; //no line break between position and this offset
+        bool streamEnded = true; //mapped files have all their data from the start
+        string_view record;
+        bool hasRecord = false;
+        vector<string_view> fields;
+        bool fieldsSplit = false;
+        char delimiter = ',';
+
+        bool map(){
+            struct stat status;
+            if(fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size == 0){
+                return false;
+            }
+            void* memory = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if(memory == MAP_FAILED){
+                return false;
+            }
+            madvise(memory, size_t(status.st_size), MADV_SEQUENTIAL); //read ahead and drop pages behind the scan early
+            shared_ptr<Mapping> mapping = make_shared<Mapping>();
+            mapping->data = memory;
+            mapping->size = size_t(status.st_size);
+            owner = mapping;
+            data = static_cast<const char*>(memory);
+            size = mapping->size;
+            return true;
+        }
+
+        bool readBlock(){ //appends the next bytes of the stream behind the filled part of the block, which views may point into
+            if(size == capacity){ //full, the unread rest moves into a new block that grows with long lines
+                size_t rest = size - position;
+                size_t newCapacity = max(blockSize, 2 * rest);
+                shared_ptr<char> newBlock(new char[newCapacity], default_delete<char[]>());
+                memcpy(newBlock.get(), data + position, rest);
+                owner = newBlock;
+                block = newBlock.get();
+                capacity = newCapacity;
+                data = block;
+                size = rest;
+                searched -= position;
+                position = 0;
+            }
+            ssize_t count = 0;
+            do{
+                count = read(descriptor, block + size, capacity - size);
+            }while(count < 0 && errno == EINTR);
+            if(count <= 0){
+                streamEnded = true;
+                return false;
+            }
+            size += size_t(count);
+            return true;
+        }
+
+    public:
+        InputFile(){}
+        InputFile(const InputFile&) = delete;
+        InputFile& operator=(const InputFile&) = delete;
+        ~InputFile(){
+            close();
+        }
+
+        bool open(const string& path, char fieldDelimiter){ //"-" reads standard input
+            delimiter = fieldDelimiter;
+            descriptor = path == "-" ? 0 : ::open(path.c_str(), O_RDONLY);
+            if(descriptor < 0){
+                return false;
+            }
+            streamEnded = map();
+            return true;
+        }
+
+        bool next(){
+            hasRecord = false;
+            fieldsSplit = false;
+            while(true){
+                size_t from = max(position, searched); //bytes of a long line are scanned once, not again after every read
+                const char* lineEnd = size > from ? static_cast<const char*>(memchr(data + from, '\n', size - from)) : nullptr;
+                if(lineEnd == nullptr && !streamEnded){
+                    searched = size;
+                    readBlock();
+                    continue;
+                }
+                if(lineEnd == nullptr && position >= size){
+                    return false;
+                }
+                size_t end = lineEnd != nullptr ? size_t(lineEnd - data) : size; //the last line may have no line break
+                record = string_view(data + position, end - position);
+                if(!record.empty() && record.back() == '\r'){
+                    record.remove_suffix(1);
+                }
+                position = lineEnd != nullptr ? end + 1 : size;
+                hasRecord = true;
+                return true;
+            }
+        }
+
+        bool hasLine() const{
+            return hasRecord;
+        }
+
+        string_view line() const{
+            return record;
+        }
+
+        const vector<string_view>& splitFields(){ //fields of the current line, split once per line
+            if(!fieldsSplit){
+                fields.clear();
+                size_t start = 0;
+                while(true){
+                    size_t end = record.find(delimiter, start);
+                    fields.push_back(record.substr(start, end == string_view::npos ? string_view::npos : end - start));
+                    if(end == string_view::npos){
+                        break;
+                    }
+                    start = end + 1;
+                }
+                fieldsSplit = true;
+            }
+            return fields;
+        }
+
+        const shared_ptr<const void>& source() const{ //owner of the memory the current line points into
+            return owner;
+        }
+
+        void close(){ //views handed out before stay valid
+            if(descriptor > 0){
+                ::close(descriptor);
+            }
+            descriptor = -1;
+            owner = nullptr;
+            data = nullptr;
+            block = nullptr;
+            size = position = capacity = searched = 0;
+            streamEnded = true;
+            hasRecord = false;
+        }
+};
+
+struct FileValue:R_Value{
+    string path;
+    InputFile file;
+    FileValue(string path):R_Value(ValueType::FileValue),path(move(path)){}
+    void print() const override{
+        cout<<"\n FileValue ( "<<path<<" )";
+    }
+};
+
+
+#endif
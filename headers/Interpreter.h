@@ -4,310 +4,966 @@
 #include "Values.h"
 #include "AstNodes.h"
 #include "Environment.h"
+#include "ExecutionLimits.h"
+#include "LoopAnalysis.h"
+#include "ThreadPool.h"
+#include "GreenThreads.h"
 #include <cstdlib>
+#include <sstream>
 #include <memory>
+#include <chrono>
 
 using namespace std;
 
 class Interpreter{
     private:
+        vector<shared_ptr<R_Value>> stack; //call arguments and frames of user functions
+        size_t frameBase = 0;
+        FunctionValue* currentFunction = nullptr;
+        bool returning = false;
+        shared_ptr<R_Value> returnValue;
+        shared_ptr<FunctionValue> tailCallee;
+        vector<shared_ptr<R_Value>> invariants; //values of hoisted loop expressions, indexed by InvariantNode::slot
+
+        ExecutionLimits limits;
+        uint64_t stepsTaken = 0;
+        int64_t stepWindow = INT64_MAX; //steps are counted down and only checked against the limits once per window
+        int64_t stepsUntilCheck = INT64_MAX;
+        chrono::steady_clock::time_point deadline;
+
+        size_t callDepth = 0;
+        const char* stackEnd = nullptr; //stackLimit() of the thread this interpreter runs on, looked up on the first call
+
+        ostream* output = &cout;
+        bool parallelWorker = false; //runs one chunk of a parallel for, nested parallel loops stay sequential
+
+        void countStep(){
+            if(--stepsUntilCheck <= 0){
+                checkLimits();
+            }
+        }
+
+        void checkLimits(){
+            stepsTaken += stepWindow - stepsUntilCheck;
+            if(limits.maxSteps > 0 && stepsTaken >= limits.maxSteps){
+                throw ExecutionLimitExceeded("step limit of " + to_string(limits.maxSteps) + " steps");
+            }
+            if(limits.timeoutMs > 0 && chrono::steady_clock::now() >= deadline){
+                throw ExecutionLimitExceeded("timeout of " + to_string(limits.timeoutMs) + " ms");
+            }
+            startStepWindow();
+        }
+
+        void startStepWindow(){
+            stepWindow = INT64_MAX;
+            if(limits.timeoutMs > 0){
+                stepWindow = 1024;
+            }
+            if(limits.maxSteps > 0){
+                stepWindow = min<int64_t>(stepWindow, limits.maxSteps - stepsTaken);
+            }
+            stepsUntilCheck = stepWindow;
+        }
+
+        void resetState(){
+            stack.clear();
+            frameBase = 0;
+            currentFunction = nullptr;
+            returning = false;
+            returnValue = nullptr;
+            tailCallee = nullptr;
+            invariants.clear();
+            callDepth = 0;
+        }
+
     public:
-        shared_ptr<R_Value> evaluate(shared_ptr<Statement> astNode, shared_ptr<Environment> environment){
+        void setLimits(const ExecutionLimits& executionLimits){
+            limits = executionLimits;
+        }
+
+        void setOutput(ostream& stream){
+            output = &stream;
+        }
+
+        uint64_t getStepsTaken() const{
+            return stepsTaken + (stepWindow - stepsUntilCheck);
+        }
+
+        shared_ptr<R_Value> run(const shared_ptr<Statement>& program, const shared_ptr<Environment>& environment){ //evaluates under the configured limits, ExecutionLimitExceeded leaves the interpreter reusable
+            if(program->node == NodeType::ProgramNode){
+                invariants.assign(static_cast<Program*>(program.get())->invariantSlots, nullptr);
+            }
+            return runWithLimits([&]{
+                return evaluate(program, environment);
+            });
+        }
+
+        template<typename NextStatement>
+        shared_ptr<R_Value> runStream(NextStatement nextStatement, const shared_ptr<Environment>& environment){ //evaluates and releases one statement at a time until nextStatement() gives back nullptr
+            return runWithLimits([&]{
+                shared_ptr<R_Value> result = makeNullValue();
+                for(shared_ptr<Statement> statement = nextStatement(); statement != nullptr; statement = nextStatement()){
+                    countStep();
+                    result = evaluate(statement, environment);
+                }
+                return result;
+            });
+        }
+
+        template<typename Body>
+        shared_ptr<R_Value> runWithLimits(Body body){
+            stepsTaken = 0;
+            deadline = chrono::steady_clock::now() + chrono::milliseconds(limits.timeoutMs);
+            startStepWindow();
+            shared_ptr<MemoryBudget> previousBudget = activeMemoryBudget();
+            if(limits.maxMemoryBytes > 0){
+                activeMemoryBudget() = make_shared<MemoryBudget>(limits.maxMemoryBytes);
+            }
+            try{
+                shared_ptr<R_Value> result = body();
+                activeMemoryBudget() = previousBudget;
+                return result;
+            }catch(...){
+                resetState();
+                activeMemoryBudget() = previousBudget;
+                throw;
+            }
+        }
+
+        shared_ptr<R_Value> evaluate(const shared_ptr<Statement>& astNode, const shared_ptr<Environment>& environment){
            switch(astNode->node){
                 case NodeType::ProgramNode:                
                     {
-                        shared_ptr<Program> programNode = dynamic_pointer_cast<Program>(astNode);
+                        Program* programNode = static_cast<Program*>(astNode.get());
                         return evaluateProgramNode(programNode,environment);
                     }
                 case NodeType::NumberNode:
                     {
-                        shared_ptr<NumberNode> numberNode = dynamic_pointer_cast<NumberNode>(astNode);
+                        NumberNode* numberNode = static_cast<NumberNode*>(astNode.get());
                         return evaluateNumberNode(numberNode,environment);
                     }
                 case NodeType::StringNode:
                     {
-                        shared_ptr<StringNode> stringNode = dynamic_pointer_cast<StringNode>(astNode);
+                        StringNode* stringNode = static_cast<StringNode*>(astNode.get());
                         return evaluateStringNode(stringNode,environment);
                     }
                 case NodeType::IdentifierNode:
                     {
-                        shared_ptr<IdentifierNode> identifierNode = dynamic_pointer_cast<IdentifierNode>(astNode);
+                        IdentifierNode* identifierNode = static_cast<IdentifierNode*>(astNode.get());
                         return evaluateIdentifierNode(identifierNode,environment);
                     }
                 case NodeType::BinaryNode:
                     {
-                        shared_ptr<BinaryNode> binaryNode = dynamic_pointer_cast<BinaryNode>(astNode);
+                        BinaryNode* binaryNode = static_cast<BinaryNode*>(astNode.get());
                         return evaluateBinaryNode(binaryNode,environment);
                     }
                 case NodeType::VariableDeclarationNode:
                     {
-                        shared_ptr<VariableDeclarationNode> variableDeclarationNode = dynamic_pointer_cast<VariableDeclarationNode>(astNode);
+                        VariableDeclarationNode* variableDeclarationNode = static_cast<VariableDeclarationNode*>(astNode.get());
                         return evaluateVariableDeclarationNode(variableDeclarationNode,environment);
                     }
                 case NodeType::VariableAssignmentNode:
                     {
-                        shared_ptr<VariableAssignmentNode> variableAssignmentNode = dynamic_pointer_cast<VariableAssignmentNode>(astNode);
+                        VariableAssignmentNode* variableAssignmentNode = static_cast<VariableAssignmentNode*>(astNode.get());
                         return evaluateVariableAssignmentNode(variableAssignmentNode,environment);
                     }
                 case NodeType::PrintNode:
                     {
-                        shared_ptr<PrintNode> printNode = dynamic_pointer_cast<PrintNode>(astNode);
+                        PrintNode* printNode = static_cast<PrintNode*>(astNode.get());
                         return evaluatePrintNode(printNode,environment);
                     }
                 case NodeType::IfNode:
                     {
-                        shared_ptr<IfNode> ifNode = dynamic_pointer_cast<IfNode>(astNode);
+                        IfNode* ifNode = static_cast<IfNode*>(astNode.get());
                         return evaluateIfNode(ifNode,environment);
                     }
                 case NodeType::ConditionalNode:
                     {
-                        shared_ptr<ConditionalNode> conditionalNode = dynamic_pointer_cast<ConditionalNode>(astNode);
+                        ConditionalNode* conditionalNode = static_cast<ConditionalNode*>(astNode.get());
                         return evaluateConditionalNode(conditionalNode,environment);
                     }
                 case NodeType::ForNode:
                     {
-                        shared_ptr<ForNode> forNode = dynamic_pointer_cast<ForNode>(astNode);
+                        ForNode* forNode = static_cast<ForNode*>(astNode.get());
                         return evaluateForNode(forNode,environment);
                     }
+                case NodeType::ObjectLiteralNode:
+                    {
+                        ObjectLiteralNode* objectLiteralNode = static_cast<ObjectLiteralNode*>(astNode.get());
+                        return evaluateObjectLiteralNode(objectLiteralNode,environment);
+                    }
+                case NodeType::MemberNode:
+                    {
+                        MemberNode* memberNode = static_cast<MemberNode*>(astNode.get());
+                        return evaluateMemberNode(memberNode,environment);
+                    }
+                case NodeType::CallNode:
+                    {
+                        CallNode* callNode = static_cast<CallNode*>(astNode.get());
+                        return evaluateCallNode(callNode,environment);
+                    }
+                case NodeType::FunctionDeclarationNode:
+                    {
+                        shared_ptr<FunctionDeclarationNode> functionDeclarationNode = static_pointer_cast<FunctionDeclarationNode>(astNode);
+                        return evaluateFunctionDeclarationNode(functionDeclarationNode,environment);
+                    }
+                case NodeType::ReturnNode:
+                    {
+                        ReturnNode* returnNode = static_cast<ReturnNode*>(astNode.get());
+                        return evaluateReturnNode(returnNode,environment);
+                    }
+                case NodeType::DictionaryLiteralNode:
+                    {
+                        DictionaryLiteralNode* dictionaryLiteralNode = static_cast<DictionaryLiteralNode*>(astNode.get());
+                        return evaluateDictionaryLiteralNode(dictionaryLiteralNode,environment);
+                    }
+                case NodeType::ArrayLiteralNode:
+                    {
+                        ArrayLiteralNode* arrayLiteralNode = static_cast<ArrayLiteralNode*>(astNode.get());
+                        return evaluateArrayLiteralNode(arrayLiteralNode,environment);
+                    }
+                case NodeType::InvariantNode:
+                    {
+                        InvariantNode* invariantNode = static_cast<InvariantNode*>(astNode.get());
+                        return evaluateInvariantNode(invariantNode,environment);
+                    }
                 default:
-                    cerr<<"\n[[Stage]] : Interpreting  [[ERROR]] : Invalid node type\n";
                     astNode->print();
-                    exit(1);
+                    runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Invalid node type\n");
            } 
         }
 
-        shared_ptr<R_Value> evaluateProgramNode(shared_ptr<Program> programNode,shared_ptr<Environment> environment){
+        shared_ptr<R_Value> evaluateProgramNode(Program* programNode, const shared_ptr<Environment>& environment){
            shared_ptr<R_Value> result;
             for (auto& statement : programNode->statements){
+               countStep();
                result = evaluate(statement, environment);
             } 
             return result;
         }
 
-        shared_ptr<R_Value> evaluateNumberNode(shared_ptr<NumberNode> numberNode,shared_ptr<Environment> environment){
-            shared_ptr<NumberValue> numValue = make_shared<NumberValue>();
-            numValue->value = numberNode->value;
-            return numValue;
+        shared_ptr<R_Value> evaluateNumberNode(NumberNode* numberNode, const shared_ptr<Environment>& environment){
+            return numberNode->isInteger ? makeIntegerValue(numberNode->integer) : makeNumberValue(numberNode->value);
         }
 
-        shared_ptr<R_Value> evaluateStringNode(shared_ptr<StringNode> stringNode,shared_ptr<Environment> environment){
-            shared_ptr<StringValue> stringValue = make_shared<StringValue>();
-            stringValue->value = stringNode->value;
-            return stringValue;
+        shared_ptr<R_Value> evaluateStringNode(StringNode* stringNode, const shared_ptr<Environment>& environment){
+            return stringNode->interned;
         }
 
-        shared_ptr<R_Value> evaluateIdentifierNode(shared_ptr<IdentifierNode> identifierNode,shared_ptr<Environment> environment){
-            return environment->lookupVariable(identifierNode->value);
+        shared_ptr<R_Value> evaluateIdentifierNode(IdentifierNode* identifierNode, const shared_ptr<Environment>& environment){
+            if(identifierNode->slot >= 0){
+                return stack[frameBase + identifierNode->slot];
+            }
+            if(identifierNode->capture >= 0){
+                return currentFunction->captures[identifierNode->capture];
+            }
+            return environment->lookupVariable(identifierNode->atom);
         }
 
-        shared_ptr<R_Value> evaluateBinaryNode(shared_ptr<BinaryNode> binaryNode,shared_ptr<Environment> environment){
+        shared_ptr<R_Value> evaluateBinaryNode(BinaryNode* binaryNode, const shared_ptr<Environment>& environment){
             shared_ptr<R_Value> left = evaluate(binaryNode->left,environment);
             shared_ptr<R_Value> right = evaluate(binaryNode->right,environment);
 
+            if(binaryNode->operands == OperandTypes::Numbers){
+                return evaluateCaseNumericBinaryNode(binaryNode->opCode, static_cast<NumberValue*>(left.get()), static_cast<NumberValue*>(right.get()));
+            }else if(binaryNode->operands == OperandTypes::Strings){
+                return evaluateCaseStringBinaryNode(binaryNode, static_cast<StringValue*>(left.get()), static_cast<StringValue*>(right.get()));
+            }
             if(left->type == ValueType::NumberValue && right->type == ValueType::NumberValue){
-                return evaluateCaseNumericBinaryNode(binaryNode, dynamic_pointer_cast<NumberValue>(left), dynamic_pointer_cast<NumberValue>(right));
+                return evaluateCaseNumericBinaryNode(binaryNode->opCode, static_cast<NumberValue*>(left.get()), static_cast<NumberValue*>(right.get()));
             }else if (left->type == ValueType::StringValue && right ->type == ValueType::StringValue){
-                return evaluateCaseStringBinaryNode(binaryNode, dynamic_pointer_cast<StringValue>(left), dynamic_pointer_cast<StringValue>(right)); 
+                return evaluateCaseStringBinaryNode(binaryNode, static_cast<StringValue*>(left.get()), static_cast<StringValue*>(right.get())); 
             }else if(left->type == ValueType::NumberValue && right->type == ValueType::StringValue){
-                return evaluateCaseNumericStringBinaryNode(binaryNode, dynamic_pointer_cast<NumberValue>(left), dynamic_pointer_cast<StringValue>(right));
+                return evaluateCaseNumericStringBinaryNode(binaryNode, static_cast<NumberValue*>(left.get()), static_cast<StringValue*>(right.get()));
             }else if(left->type == ValueType::StringValue && right->type == ValueType::NumberValue){
-                return evaluateCaseNumericStringBinaryNode(binaryNode, dynamic_pointer_cast<StringValue>(left), dynamic_pointer_cast<NumberValue>(right));
+                return evaluateCaseNumericStringBinaryNode(binaryNode, static_cast<StringValue*>(left.get()), static_cast<NumberValue*>(right.get()));
             }else if(left->type == ValueType::BoolValue && right -> type == ValueType::StringValue){
-                return evaluateCaseStringBooleanBinaryNode(binaryNode, dynamic_pointer_cast<BoolValue>(left), dynamic_pointer_cast<StringValue>(right));
+                return evaluateCaseStringBooleanBinaryNode(static_cast<BoolValue*>(left.get()), static_cast<StringValue*>(right.get()));
             }else if(left->type == ValueType::StringValue && right -> type == ValueType::BoolValue){
-                return evaluateCaseStringBooleanBinaryNode(binaryNode, dynamic_pointer_cast<StringValue>(left), dynamic_pointer_cast<BoolValue>(right));
+                return evaluateCaseStringBooleanBinaryNode(static_cast<StringValue*>(left.get()), static_cast<BoolValue*>(right.get()));
             }else{
-                cerr<<"\n[[Stage]] : Interpreting  [[ERROR]] : Invalid binary operator / Case not found " <<binaryNode->op<<" \n";
-                exit(1);
-            }
-        }
-
-        shared_ptr<R_Value> evaluateCaseNumericBinaryNode(shared_ptr<BinaryNode> binaryNode, shared_ptr<NumberValue> left, shared_ptr<NumberValue> right){
-            shared_ptr<NumberValue> result = make_shared<NumberValue>();
-            
-            if (binaryNode->op == "+"){
-                result->value = left->value + right->value;
-            }else if (binaryNode->op == "-"){
-                result->value = left->value - right->value;
-            }else if (binaryNode->op == "*"){
-                result->value = left->value * right->value; 
-            }else if (binaryNode->op == "/"){
-                result->value = left->value / right->value; 
-            }else if (binaryNode->op == "%"){
-                result->value = (int)left->value % (int)right->value;
-            }else{
-                cerr<<"\n[[Stage]] : Interpreting  [[ERROR]] : Invalid binary operator " <<binaryNode->op<<" \n";
-                exit(1);
+                runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Invalid binary operator / Case not found ", binaryNode->op, " \n");
             }
+        }
 
-            return result;
+        shared_ptr<R_Value> evaluateCaseNumericBinaryNode(char opCode, NumberValue* left, NumberValue* right){
+            if(left->isInteger && right->isInteger){ //exact 64 bit arithmetic, falls back to double on overflow
+                int64_t result = 0;
+                switch(opCode){
+                    case '+':
+                        if(!__builtin_add_overflow(left->integer, right->integer, &result)){
+                            return makeIntegerValue(result);
+                        }
+                        break;
+                    case '-':
+                        if(!__builtin_sub_overflow(left->integer, right->integer, &result)){
+                            return makeIntegerValue(result);
+                        }
+                        break;
+                    case '*':
+                        if(!__builtin_mul_overflow(left->integer, right->integer, &result)){
+                            return makeIntegerValue(result);
+                        }
+                        break;
+                    case '/':
+                        if(right->integer != 0 && right->integer != -1 && left->integer % right->integer == 0){
+                            return makeIntegerValue(left->integer / right->integer);
+                        }
+                        break;
+                    case '%':
+                        if(right->integer == 0){
+                            runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Modulo by zero \n");
+                        }
+                        return makeIntegerValue(right->integer == -1 ? 0 : left->integer % right->integer);
+                }
+            }
+
+            switch(opCode){
+                case '+':
+                    return makeNumberValue(left->value + right->value);
+                case '-':
+                    return makeNumberValue(left->value - right->value);
+                case '*':
+                    return makeNumberValue(left->value * right->value);
+                case '/':
+                    return makeNumberValue(left->value / right->value);
+                case '%':
+                    if(right->value == 0){
+                        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Modulo by zero \n");
+                    }
+                    return makeNumberValue(fmod(left->value, right->value));
+                default:
+                    runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Invalid binary operator ", opCode, " \n");
+            }
         }
 
-        shared_ptr<R_Value> evaluateCaseStringBinaryNode(shared_ptr<BinaryNode> binaryNode, shared_ptr<StringValue> left, shared_ptr<StringValue> right){
-            shared_ptr<StringValue> result = make_shared<StringValue>(); 
+        static string concatenationBuffer(size_t bytes){ //empty string with room for the result, checked against the memory limit first
+            reserveMemory(int64_t(sizeof(StringValue) + bytes));
+            string text;
+            text.reserve(bytes);
+            return text;
+        }
 
-            if (binaryNode->op == "+"){
-               result->value = left->value + right->value;
-            }else{
-                cerr<<"\n[[Stage]] : Interpreting  [[ERROR]] : Invalid String binary operator " <<binaryNode->op<<" \n";
-                exit(1);
+        shared_ptr<R_Value> evaluateCaseStringBinaryNode(BinaryNode* binaryNode, StringValue* left, StringValue* right){
+            if (binaryNode->opCode != '+'){
+                runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Invalid String binary operator ", binaryNode->op, " \n");
+            }
+            string text = concatenationBuffer(left->text().size() + right->text().size());
+            text += left->text();
+            text += right->text();
+            return makeStringValue(move(text));
+        }
+
+        shared_ptr<R_Value> evaluateCaseNumericStringBinaryNode(BinaryNode* binaryNode, NumberValue* left, StringValue* right){
+            string text;
+            if (binaryNode->opCode == '+'){
+                text = concatenationBuffer(24 + right->text().size());
+                appendNumber(text, *left);
+                text += right->text();
+            }
+            return makeStringValue(move(text));
+        }
+        
+        shared_ptr<R_Value> evaluateCaseNumericStringBinaryNode(BinaryNode* binaryNode, StringValue* left, NumberValue* right){
+            string text;
+            if (binaryNode->opCode == '+'){
+                text = concatenationBuffer(left->text().size() + 24);
+                text += left->text();
+                appendNumber(text, *right);
             }
+            return makeStringValue(move(text));
+        }
 
-            return result;
+        shared_ptr<R_Value> evaluateCaseStringBooleanBinaryNode(BoolValue* left, StringValue* right){
+            string text = concatenationBuffer(5 + right->text().size());
+            text += left->value == 0 ? "false" : "true";
+            text += right->text();
+            return makeStringValue(move(text));
         }
 
-        shared_ptr<R_Value> evaluateCaseNumericStringBinaryNode(shared_ptr<BinaryNode> binaryNode, shared_ptr<NumberValue> left, shared_ptr<StringValue> right){
-            shared_ptr<StringValue> result = make_shared<StringValue>();
+        shared_ptr<R_Value> evaluateCaseStringBooleanBinaryNode(StringValue* left, BoolValue* right){
+            string text = concatenationBuffer(left->text().size() + 5);
+            text += left->text();
+            text += right->value == 0 ? "false" : "true";
+            return makeStringValue(move(text));
+        }
 
-            if (binaryNode->op == "+"){
-                if (floor(left->value) == left->value ){
-                    result->value = to_string(int(left->value)) + right->value;
-                }else{
-                    result->value = to_string(left->value) + right->value;   
+
+        shared_ptr<R_Value> evaluateVariableDeclarationNode(VariableDeclarationNode* variableDeclarationNode, const shared_ptr<Environment>& environment){
+            shared_ptr<R_Value> result = variableDeclarationNode->value ? evaluate(variableDeclarationNode->value, environment) : makeNullValue();
+            if(variableDeclarationNode->slot >= 0){
+                stack[frameBase + variableDeclarationNode->slot] = result;
+                return result;
+            }
+            return environment->declareVariable(variableDeclarationNode->atom,result,variableDeclarationNode->IsConstant);
+        }
+
+        shared_ptr<R_Value> evaluateVariableAssignmentNode(VariableAssignmentNode* variableAssignmentNode, const shared_ptr<Environment>& environment){
+            if(variableAssignmentNode->assignmentVariable->node == NodeType::MemberNode){
+                return evaluatePropertyAssignment(static_cast<MemberNode*>(variableAssignmentNode->assignmentVariable.get()), variableAssignmentNode->value, environment);
+            }
+            if(variableAssignmentNode->assignmentVariable->node != NodeType::IdentifierNode){
+                runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Invalid assignment variable type \n");
+            }
+            IdentifierNode* identifierNode = static_cast<IdentifierNode*>(variableAssignmentNode->assignmentVariable.get());
+            if(identifierNode->slot >= 0){
+                shared_ptr<R_Value> value = evaluate(variableAssignmentNode->value,environment);
+                stack[frameBase + identifierNode->slot] = value;
+                return value;
+            }
+            return environment->assignVariable(identifierNode->atom,evaluate(variableAssignmentNode->value,environment));
+        }
+
+        shared_ptr<R_Value> evaluateObjectLiteralNode(ObjectLiteralNode* objectLiteralNode, const shared_ptr<Environment>& environment){
+            if(objectLiteralNode->shape == nullptr){
+                Shape* shape = emptyShape();
+                for(auto& property : objectLiteralNode->properties){
+                    shape = shape->withProperty(property.first);
                 }
+                objectLiteralNode->shape = shape;
+            }
+            shared_ptr<ObjectValue> object = makeObjectValue();
+            object->shape = objectLiteralNode->shape;
+            object->slots.reserve(objectLiteralNode->properties.size());
+            for(auto& property : objectLiteralNode->properties){
+                object->addSlot(evaluate(property.second, environment));
             }
+            return object;
+        }
 
+        ObjectValue* evaluateMemberObject(MemberNode* memberNode, const shared_ptr<R_Value>& target){
+            if(target->type != ValueType::ObjectValue){
+                runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Cannot access property '", memberNode->property, "' of a non-object value\n");
+            }
+            return static_cast<ObjectValue*>(target.get());
+        }
 
-            return result;
+        shared_ptr<R_Value> evaluateMemberNode(MemberNode* memberNode, const shared_ptr<Environment>& environment){
+            shared_ptr<R_Value> target = evaluate(memberNode->object, environment);
+            ObjectValue* object = evaluateMemberObject(memberNode, target);
+            PropertyCache& cache = memberNode->cache;
+            if(object->shape != cache.shape){
+                int slot = object->shape->findSlot(memberNode->property);
+                if(slot < 0){
+                    runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Property not defined ---- Property : ", memberNode->property, "\n");
+                }
+                cache.shape = object->shape;
+                cache.transition = nullptr;
+                cache.slot = slot;
+            }
+            return object->slots[cache.slot];
         }
-        
-        shared_ptr<R_Value> evaluateCaseNumericStringBinaryNode(shared_ptr<BinaryNode> binaryNode, shared_ptr<StringValue> left, shared_ptr<NumberValue> right){
-            shared_ptr<StringValue> result = make_shared<StringValue>();
 
-            if (binaryNode->op == "+"){
-                if(floor(right->value) == right->value){
-                    result->value = left->value + to_string(int(right->value));
+        shared_ptr<R_Value> evaluatePropertyAssignment(MemberNode* memberNode, const shared_ptr<Expression>& valueNode, const shared_ptr<Environment>& environment){
+            shared_ptr<R_Value> target = evaluate(memberNode->object, environment);
+            ObjectValue* object = evaluateMemberObject(memberNode, target);
+            shared_ptr<R_Value> value = evaluate(valueNode, environment);
+            PropertyCache& cache = memberNode->cache;
+            if(object->shape != cache.shape){
+                int slot = object->shape->findSlot(memberNode->property);
+                cache.shape = object->shape;
+                if(slot >= 0){
+                    cache.transition = nullptr;
+                    cache.slot = slot;
                 }else{
-                    result->value = left->value + to_string(right->value) ;   
+                    cache.transition = object->shape->withProperty(memberNode->property);
+                    cache.slot = object->slots.size();
                 }
             }
+            if(cache.transition != nullptr){
+                object->addSlot(value);
+                object->shape = cache.transition;
+            }else{
+                object->slots[cache.slot] = value;
+            }
+            return value;
+        }
 
+        shared_ptr<R_Value> evaluateCallNode(CallNode* callNode, const shared_ptr<Environment>& environment){
+            shared_ptr<R_Value> callee = evaluate(callNode->callee, environment);
+            size_t base = pushArguments(callee, callNode, environment);
+            if(callee->type == ValueType::FunctionValue){
+                return callFunction(static_pointer_cast<FunctionValue>(callee), base);
+            }
+            NativeFunctionValue* function = static_cast<NativeFunctionValue*>(callee.get());
+            shared_ptr<R_Value> result = function->function(*this, stack.data() + base, callNode->arguments.size());
+            stack.resize(base);
             return result;
         }
 
-        shared_ptr<R_Value> evaluateCaseStringBooleanBinaryNode(shared_ptr<BinaryNode> binaryNode ,shared_ptr<BoolValue> left, shared_ptr<StringValue> right){
-            shared_ptr<StringValue> result = make_shared<StringValue>();
-
-            if(binaryNode->op == "+"){
-                result->value = left->value == 0 ? "false" : "true" + right->value;
+        size_t pushArguments(const shared_ptr<R_Value>& callee, CallNode* callNode, const shared_ptr<Environment>& environment){
+            size_t argumentCount = callNode->arguments.size();
+            if(callee->type == ValueType::NativeFunctionValue){
+                NativeFunctionValue* function = static_cast<NativeFunctionValue*>(callee.get());
+                if(function->arity >= 0 && argumentCount != size_t(function->arity)){
+                    runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Function '", function->name, "' expects ", function->arity, " arguments, got ", argumentCount, "\n");
+                }
+            }else if(callee->type == ValueType::FunctionValue){
+                FunctionValue* function = static_cast<FunctionValue*>(callee.get());
+                if(argumentCount != function->declaration->parameters.size()){
+                    runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Function '", function->name, "' expects ", function->declaration->parameters.size(), " arguments, got ", argumentCount, "\n");
+                }
             }else{
-                result->value = left->value == 0 ? "false" : "true" + right->value;
+                runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Called value is not a function\n");
             }
+            size_t base = stack.size();
+            for(auto& argument : callNode->arguments){
+                shared_ptr<R_Value> value = evaluate(argument, environment);
+                stack.push_back(value);
+            }
+            return base;
+        }
 
+        shared_ptr<R_Value> callValue(const shared_ptr<R_Value>& callee, const shared_ptr<R_Value>* arguments, size_t argumentCount){ //the arity is checked by the caller
+            size_t base = stack.size();
+            stack.insert(stack.end(), arguments, arguments + argumentCount);
+            if(callee->type == ValueType::FunctionValue){
+                return callFunction(static_pointer_cast<FunctionValue>(callee), base);
+            }
+            NativeFunctionValue* function = static_cast<NativeFunctionValue*>(callee.get());
+            shared_ptr<R_Value> result = function->function(*this, stack.data() + base, argumentCount);
+            stack.resize(base);
             return result;
         }
 
-        shared_ptr<R_Value> evaluateCaseStringBooleanBinaryNode(shared_ptr<BinaryNode> binaryNode, shared_ptr<StringValue> left, shared_ptr<BoolValue> right){
-            shared_ptr<StringValue> result = make_shared<StringValue>();
-
-            if(binaryNode->op == "+"){
-                result->value = left->value + (right->value == 0 ? "false" : "true");
-            }else{
-                result->value = left->value + (right->value == 0 ? "false" : "true");
+        void enterCall(){ //deep recursion ends the script before it overflows the stack of its thread
+            if(stackEnd == nullptr){
+                stackEnd = stackLimit();
+            }
+            char here;
+            callDepth++;
+            if(limits.maxCallDepth > 0 && callDepth > limits.maxCallDepth){
+                runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Maximum call depth exceeded ---- Depth : ", callDepth, "\n");
             }
+            if(stackEnd != nullptr && &here < stackEnd){ //how deep that is depends on the expressions of the calls, so it is not printed
+                runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Maximum call depth exceeded ---- Stack of the thread used up\n");
+            }
+        }
 
+        shared_ptr<R_Value> callFunction(shared_ptr<FunctionValue> function, size_t base){
+            enterCall();
+            size_t callerFrameBase = frameBase;
+            FunctionValue* callerFunction = currentFunction;
+            shared_ptr<R_Value> result;
+            while(true){
+                frameBase = base;
+                currentFunction = function.get();
+                stack.resize(base + function->declaration->frameSize);
+                for(auto& statement : function->declaration->body){
+                    countStep();
+                    evaluate(statement, function->closure);
+                    if(returning){
+                        break;
+                    }
+                }
+                returning = false;
+                if(tailCallee == nullptr){ //a tail call reuses this frame, its arguments were already moved to the frame base
+                    result = returnValue ? returnValue : makeNullValue();
+                    returnValue = nullptr;
+                    break;
+                }
+                function = tailCallee;
+                tailCallee = nullptr;
+            }
+            stack.resize(base);
+            frameBase = callerFrameBase;
+            currentFunction = callerFunction;
+            callDepth--;
             return result;
         }
 
-
-        shared_ptr<R_Value> evaluateVariableDeclarationNode(shared_ptr<VariableDeclarationNode> variableDeclarationNode,shared_ptr<Environment> environment){
-            shared_ptr<R_Value> result = variableDeclarationNode->value ? evaluate(variableDeclarationNode->value, environment) : makeNullValue();
-            return environment->declareVariable(variableDeclarationNode->name,result,variableDeclarationNode->IsConstant);
+        shared_ptr<R_Value> evaluateFunctionDeclarationNode(const shared_ptr<FunctionDeclarationNode>& functionDeclarationNode, const shared_ptr<Environment>& environment){
+            shared_ptr<FunctionValue> function = makeFunctionValue(functionDeclarationNode->name, functionDeclarationNode, environment);
+            for(auto& capture : functionDeclarationNode->captures){
+                bool capturesItself = capture.fromSlot && capture.index == functionDeclarationNode->slot;
+                if(capturesItself){
+                    function->captures.push_back(function);
+                }else{
+                    function->captures.push_back(capture.fromSlot ? stack[frameBase + capture.index] : currentFunction->captures[capture.index]);
+                }
+            }
+            if(functionDeclarationNode->slot >= 0){
+                stack[frameBase + functionDeclarationNode->slot] = function;
+                for(auto& late : functionDeclarationNode->lateCaptures){
+                    R_Value* earlier = stack[frameBase + late.slot].get();
+                    if(earlier != nullptr && earlier->type == ValueType::FunctionValue && static_cast<FunctionValue*>(earlier)->declaration.get() == late.function){
+                        static_cast<FunctionValue*>(earlier)->captures[late.capture] = function;
+                    }
+                }
+                return function;
+            }
+            return environment->declareVariable(functionDeclarationNode->atom, function);
         }
 
-        shared_ptr<R_Value> evaluateVariableAssignmentNode(shared_ptr<VariableAssignmentNode> variableAssignmentNode, shared_ptr<Environment> environment){
-            if(variableAssignmentNode->assignmentVariable->node != NodeType::IdentifierNode){
-                cerr<<"\n[[Stage]] : Interpreting  [[ERROR]] : Invalid assignment variable type \n";
-                exit(1);
+        shared_ptr<R_Value> evaluateReturnNode(ReturnNode* returnNode, const shared_ptr<Environment>& environment){
+            if(returnNode->tailCall){
+                CallNode* callNode = static_cast<CallNode*>(returnNode->value.get());
+                shared_ptr<R_Value> callee = evaluate(callNode->callee, environment);
+                size_t base = pushArguments(callee, callNode, environment);
+                if(callee->type == ValueType::FunctionValue){
+                    for(size_t i = 0; i < callNode->arguments.size(); i++){
+                        stack[frameBase + i] = move(stack[base + i]);
+                    }
+                    stack.resize(frameBase + callNode->arguments.size());
+                    tailCallee = static_pointer_cast<FunctionValue>(callee);
+                    returning = true;
+                    return makeNullValue();
+                }
+                NativeFunctionValue* function = static_cast<NativeFunctionValue*>(callee.get());
+                returnValue = function->function(*this, stack.data() + base, callNode->arguments.size());
+                stack.resize(base);
+                returning = true;
+                return returnValue;
             }
-            const string variableName = dynamic_pointer_cast<IdentifierNode>(variableAssignmentNode->assignmentVariable)->value;
-            return environment->assignVariable(variableName,evaluate(variableAssignmentNode->value,environment));
+            returnValue = returnNode->value ? evaluate(returnNode->value, environment) : makeNullValue();
+            returning = true;
+            return returnValue;
         }
 
-        shared_ptr<R_Value> evaluatePrintNode(shared_ptr<PrintNode> printNode,shared_ptr<Environment> environment){
+        shared_ptr<R_Value> evaluatePrintNode(PrintNode* printNode, const shared_ptr<Environment>& environment){
             shared_ptr<R_Value> value = evaluate(printNode->value,environment);
             if(value->type == ValueType::NumberValue){
-                cout<<dynamic_pointer_cast<NumberValue>(value)->value;
+                *output<<formatNumber(*static_cast<NumberValue*>(value.get()));
             }else if(value->type == ValueType::StringValue){
-                cout<<"\n"<<dynamic_pointer_cast<StringValue>(value)->value;
+                *output<<"\n"<<static_cast<StringValue*>(value.get())->text();
             }else if(value->type == ValueType::BoolValue){
-                cout<<"\n"<<(dynamic_pointer_cast<BoolValue>(value)->value == 0? "false" : "true");                
+                *output<<"\n"<<(static_cast<BoolValue*>(value.get())->value == 0? "false" : "true");                
             }
+            greenYield();
             return value;
         }
 
-        shared_ptr<R_Value> evaluateIfNode(shared_ptr<IfNode> ifNode, shared_ptr<Environment> environment){
+        shared_ptr<R_Value> evaluateIfNode(IfNode* ifNode, const shared_ptr<Environment>& environment){
             shared_ptr<R_Value> condition = evaluate(ifNode->condition,environment);
-            if(dynamic_pointer_cast<BoolValue>(condition)->value == true){
-                shared_ptr<Environment> env = make_shared<Environment>(environment);
-                env->initEnvironment();
-                for (auto& statement : ifNode->ifBody){
-                    evaluate(statement,env);
-                }
-                return makeNullValue();
-            }else {
-                shared_ptr<Environment> env = make_shared<Environment>(environment);
-                env->initEnvironment();
-                for (auto& statement : ifNode->elseBody){
-                    evaluate(statement,env);
+            vector<shared_ptr<Statement>>& body = static_cast<BoolValue*>(condition.get())->value == true ? ifNode->ifBody : ifNode->elseBody;
+            shared_ptr<Environment> blockEnvironment;
+            if(!ifNode->usesFrame){
+                blockEnvironment = makeEnvironment(environment);
+                blockEnvironment->initEnvironment();
+            }
+            const shared_ptr<Environment>& env = ifNode->usesFrame ? environment : blockEnvironment;
+            for (auto& statement : body){
+                countStep();
+                evaluate(statement,env);
+                if(returning){
+                    break;
                 }
-                return makeNullValue();
+            }
+            return makeNullValue();
+        }
+
+        template<typename Number>
+        static bool compareNumbers(char opCode, Number left, Number right){
+            switch(opCode){
+                case '>':
+                    return left > right;
+                case '<':
+                    return left < right;
+                default:
+                    return left == right;
             }
         }
 
-        shared_ptr<R_Value> evaluateConditionalNode(shared_ptr<ConditionalNode> conditionalNode, shared_ptr<Environment> environment){
+        shared_ptr<R_Value> evaluateConditionalNode(ConditionalNode* conditionalNode, const shared_ptr<Environment>& environment){
             shared_ptr<R_Value> left = evaluate(conditionalNode->left,environment);
             shared_ptr<R_Value> right = evaluate(conditionalNode->right,environment);
-            shared_ptr<BoolValue> result = make_shared<BoolValue>();
-            if(left->type == ValueType::NumberValue && right->type == ValueType::NumberValue){
-                if(conditionalNode->conditionOperator == ">"){
-                    result->value = dynamic_pointer_cast<NumberValue>(left)->value > dynamic_pointer_cast<NumberValue>(right)->value;
-                }else if (conditionalNode->conditionOperator == "<") {
-                    result->value = dynamic_pointer_cast<NumberValue>(left)->value < dynamic_pointer_cast<NumberValue>(right)->value;
-                }else if (conditionalNode->conditionOperator == "=") {
-                    result->value = dynamic_pointer_cast<NumberValue>(left)->value == dynamic_pointer_cast<NumberValue>(right)->value;
+            bool result = false;
+            if(conditionalNode->operands == OperandTypes::Numbers || (left->type == ValueType::NumberValue && right->type == ValueType::NumberValue)){
+                NumberValue* leftNumber = static_cast<NumberValue*>(left.get());
+                NumberValue* rightNumber = static_cast<NumberValue*>(right.get());
+                if(leftNumber->isInteger && rightNumber->isInteger){
+                    result = compareNumbers(conditionalNode->opCode, leftNumber->integer, rightNumber->integer);
+                }else{
+                    result = compareNumbers(conditionalNode->opCode, leftNumber->value, rightNumber->value);
                 }
             }else if (left->type == ValueType::StringValue && right->type == ValueType::StringValue) {
                 if(conditionalNode->conditionOperator == "="){
-                    result->value = dynamic_pointer_cast<StringValue>(left)->value == dynamic_pointer_cast<StringValue>(right)->value;
+                    result = stringsEqual(static_cast<StringValue*>(left.get()), static_cast<StringValue*>(right.get()));
                 }else{
-                    cerr<<"\n[[Stage]] : Interpreting  [[ERROR]] : Invalid conditional operator ("<<conditionalNode->conditionOperator<<") for String-Values\n";
-                    exit(1);
+                    runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Invalid conditional operator (", conditionalNode->conditionOperator, ") for String-Values\n");
                 }
             }else if (left->type == ValueType::BoolValue && right->type == ValueType::BoolValue){
                 if (conditionalNode->conditionOperator == "=") {
-                    result->value = dynamic_pointer_cast<BoolValue>(left)->value == dynamic_pointer_cast<BoolValue>(right)->value;
+                    result = static_cast<BoolValue*>(left.get())->value == static_cast<BoolValue*>(right.get())->value;
                 }else{
-                    cerr<<"\n[[Stage]] : Interpreting  [[ERROR]] : Invalid conditional operator ("<<conditionalNode->conditionOperator<<") for Boolean-Values\n";
-                    exit(1);
+                    runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Invalid conditional operator (", conditionalNode->conditionOperator, ") for Boolean-Values\n");
                 }
             }else {
-                cerr<<"\n[[Stage]] : Interpreting  [[ERROR]] : Invalid conditional operation between different values\n";
-                exit(1);
+                runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Invalid conditional operation between different values\n");
+            }
+            return makeBoolValue(result);
+        }
+
+        shared_ptr<R_Value> evaluateDictionaryLiteralNode(DictionaryLiteralNode* dictionaryLiteralNode, const shared_ptr<Environment>& environment){
+            shared_ptr<DictionaryValue> dictionary = makeDictionaryValue();
+            for(size_t i = 0; i < dictionaryLiteralNode->entries.size(); i++){
+                dictionary->set(dictionaryLiteralNode->entries[i].first, dictionaryLiteralNode->hashes[i], evaluate(dictionaryLiteralNode->entries[i].second, environment));
+            }
+            return dictionary;
+        }
+
+        shared_ptr<R_Value> evaluateArrayLiteralNode(ArrayLiteralNode* arrayLiteralNode, const shared_ptr<Environment>& environment){
+            vector<double> numbers;
+            numbers.reserve(arrayLiteralNode->elements.size());
+            for(auto& element : arrayLiteralNode->elements){
+                shared_ptr<R_Value> value = evaluate(element, environment);
+                if(value->type != ValueType::NumberValue){
+                    runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Arrays hold numbers, element ", numbers.size(), " of the array literal is not a number\n");
+                }
+                numbers.push_back(static_cast<NumberValue*>(value.get())->value);
+            }
+            return makeArrayValue(move(numbers));
+        }
+
+        shared_ptr<R_Value> evaluateInvariantNode(InvariantNode* invariantNode, const shared_ptr<Environment>& environment){
+            if(size_t(invariantNode->slot) < invariants.size() && invariants[invariantNode->slot] != nullptr){
+                return invariants[invariantNode->slot];
+            }
+            shared_ptr<R_Value> value = evaluate(invariantNode->expression, environment);
+            if(size_t(invariantNode->slot) >= invariants.size()){ //statements that are streamed are numbered from 0 each, there is no program to size them from
+                invariants.resize(invariantNode->slot + 1);
+            }
+            invariants[invariantNode->slot] = value;
+            return value;
+        }
+
+        void clearInvariants(ForNode* forNode){
+            for(int slot : forNode->invariantSlots){
+                if(size_t(slot) < invariants.size()){
+                    invariants[slot] = nullptr;
+                }
             }
+        }
+
+        shared_ptr<R_Value> evaluateForNode(ForNode* forNode, const shared_ptr<Environment>& environment){ //hoisted values live for one run of the loop
+            clearInvariants(forNode);
+            shared_ptr<R_Value> result = evaluateForStatement(forNode, environment);
+            clearInvariants(forNode);
             return result;
         }
 
-        shared_ptr<R_Value>evaluateForNode(shared_ptr<ForNode> forNode, shared_ptr<Environment> environment){
-                shared_ptr<Environment> env = make_shared<Environment>(environment);
-                env->initEnvironment();
-                shared_ptr<VariableDeclarationNode> variableDeclNode = dynamic_pointer_cast<VariableDeclarationNode>(forNode->initializer);
-                shared_ptr<R_Value> initVar = evaluateVariableDeclarationNode(variableDeclNode,env);
-                shared_ptr<ConditionalNode> conditionNode = dynamic_pointer_cast<ConditionalNode>(forNode->condition);
+        shared_ptr<R_Value>evaluateForStatement(ForNode* forNode, const shared_ptr<Environment>& environment){
+                shared_ptr<Environment> env = environment;
+                if(!forNode->usesFrame){
+                    env = makeEnvironment(environment);
+                    env->initEnvironment();
+                }
+                VariableDeclarationNode* variableDeclNode = static_cast<VariableDeclarationNode*>(forNode->initializer.get());
+                evaluateVariableDeclarationNode(variableDeclNode,env);
+                if(forNode->parallel && !parallelWorker){
+                    return evaluateParallelForNode(forNode, environment, env);
+                }
+                return evaluateForLoop(forNode, env);
+        }
+
+        shared_ptr<R_Value> evaluateForLoop(ForNode* forNode, const shared_ptr<Environment>& env){
+                ConditionalNode* conditionNode = static_cast<ConditionalNode*>(forNode->condition.get());
+                VariableAssignmentNode* incrementNode = static_cast<VariableAssignmentNode*>(forNode->increment.get());
                 shared_ptr<R_Value> condition = evaluateConditionalNode(conditionNode, env);
-                while(dynamic_pointer_cast<BoolValue>(condition)->value == true){
-                    for (auto& statement : forNode->forBody){
-                        evaluate(statement,env);
+                while(static_cast<BoolValue*>(condition.get())->value == true){
+                    countStep();
+                    if(evaluateForBody(forNode, env)){
+                        return makeNullValue();
                     }
-                    shared_ptr<VariableAssignmentNode> incrementNode = dynamic_pointer_cast<VariableAssignmentNode>(forNode->increment);
                     evaluateVariableAssignmentNode(incrementNode, env);
+                    greenBackEdge();
                     condition = evaluateConditionalNode(conditionNode, env);
                 }
                 return makeNullValue();
         }
 
+        bool evaluateForBody(ForNode* forNode, const shared_ptr<Environment>& environment){ //true when a return leaves the loop
+            shared_ptr<Environment> iterationEnvironment;
+            if(forNode->bodyDeclares && !forNode->usesFrame){
+                iterationEnvironment = makeEnvironment(environment);
+                iterationEnvironment->initEnvironment();
+            }
+            const shared_ptr<Environment>& env = iterationEnvironment ? iterationEnvironment : environment;
+            for (auto& statement : forNode->forBody){
+                countStep();
+                evaluate(statement,env);
+                if(returning){
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        shared_ptr<R_Value> evaluateParallelForNode(ForNode* forNode, const shared_ptr<Environment>& environment, const shared_ptr<Environment>& loopEnvironment){
+            if(forNode->plan == nullptr){
+                forNode->plan = make_shared<ParallelLoopPlan>(ParallelLoopAnalysis().analyze(forNode, loopEnvironment));
+            }
+            ParallelLoopPlan& plan = *forNode->plan;
+            string reason = plan.reason;
+            int64_t start = 0, step = 0, iterations = 0;
+            vector<shared_ptr<R_Value>> identities;
+            if(reason.empty()){
+                reason = evaluateIterationSpace(forNode, loopEnvironment, start, step, iterations);
+            }
+            if(reason.empty()){
+                reason = reductionIdentities(plan, loopEnvironment, identities);
+            }
+            if(!reason.empty()){
+                if(!plan.warned){
+                    plan.warned = true;
+                    cerr<<"\n[[Stage]] : Interpreting  [[WARNING]] : parallel for runs sequentially, the loop "<<reason<<"\n";
+                }
+                return evaluateForLoop(forNode, loopEnvironment);
+            }
+            if(iterations < 2){
+                return evaluateForLoop(forNode, loopEnvironment);
+            }
+
+            size_t chunkCount = size_t(min<int64_t>(iterations, threadPool().size() * 4));
+            vector<ostringstream> outputs(chunkCount);
+            vector<vector<shared_ptr<R_Value>>> partials(chunkCount);
+            vector<uint64_t> chunkSteps(chunkCount, 0);
+            vector<future<void>> chunks;
+            shared_ptr<MemoryBudget> budget = activeMemoryBudget();
+            AtomTable* atoms = activeAtomTable();
+            uint64_t stepsBefore = getStepsTaken();
+            int counter = atomOf(plan.counter);
+            for(size_t chunk = 0; chunk < chunkCount; chunk++){
+                int64_t first = int64_t(__int128(iterations) * chunk / chunkCount);
+                int64_t last = int64_t(__int128(iterations) * (chunk + 1) / chunkCount);
+                chunks.push_back(threadPool().submit([&, chunk, first, last]{
+                    Interpreter worker;
+                    worker.parallelWorker = true;
+                    worker.invariants.resize(invariants.size());
+                    worker.output = &outputs[chunk];
+                    worker.limits = limits;
+                    worker.deadline = deadline;
+                    worker.stepsTaken = stepsBefore;
+                    worker.startStepWindow();
+                    shared_ptr<MemoryBudget> previousBudget = activeMemoryBudget();
+                    activeMemoryBudget() = budget;
+                    AtomTable* previousAtoms = activeAtomTable();
+                    activeAtomTable() = atoms;
+                    try{
+                        shared_ptr<Environment> chunkEnvironment = makeEnvironment(environment);
+                        chunkEnvironment->initEnvironment();
+                        chunkEnvironment->declareVariable(counter, makeIntegerValue(start + first * step));
+                        for(size_t i = 0; i < plan.reductions.size(); i++){
+                            chunkEnvironment->declareVariable(plan.reductions[i].name, identities[i]);
+                        }
+                        for(int64_t iteration = first; iteration < last; iteration++){
+                            chunkEnvironment->assignVariable(counter, makeIntegerValue(start + iteration * step));
+                            worker.countStep();
+                            worker.evaluateForBody(forNode, chunkEnvironment);
+                        }
+                        for(auto& reduction : plan.reductions){
+                            partials[chunk].push_back(chunkEnvironment->lookupVariable(reduction.name));
+                        }
+                    }catch(...){
+                        activeMemoryBudget() = previousBudget;
+                        activeAtomTable() = previousAtoms;
+                        throw;
+                    }
+                    activeMemoryBudget() = previousBudget;
+                    activeAtomTable() = previousAtoms;
+                    chunkSteps[chunk] = worker.getStepsTaken() - stepsBefore;
+                }));
+            }
+            for(auto& chunk : chunks){
+                chunk.wait();
+            }
+            for(size_t chunk = 0; chunk < chunkCount; chunk++){ //output keeps iteration order, the first failing chunk ends the loop
+                *output<<outputs[chunk].str();
+                chunks[chunk].get();
+                stepsTaken += chunkSteps[chunk];
+            }
+            checkLimits();
+
+            for(size_t i = 0; i < plan.reductions.size(); i++){ //partials are merged in chunk order, so results do not depend on scheduling
+                const Reduction& reduction = plan.reductions[i];
+                shared_ptr<R_Value> value = loopEnvironment->lookupVariable(reduction.name);
+                for(size_t chunk = 0; chunk < chunkCount; chunk++){
+                    value = mergeReduction(reduction, value, partials[chunk][i]);
+                }
+                loopEnvironment->assignVariable(reduction.name, value);
+            }
+            return makeNullValue();
+        }
+
+        string evaluateIterationSpace(ForNode* forNode, const shared_ptr<Environment>& loopEnvironment, int64_t& start, int64_t& step, int64_t& iterations){
+            ConditionalNode* conditionNode = static_cast<ConditionalNode*>(forNode->condition.get());
+            BinaryNode* stepNode = static_cast<BinaryNode*>(static_cast<VariableAssignmentNode*>(forNode->increment.get())->value.get());
+            shared_ptr<R_Value> values[3] = {
+                loopEnvironment->lookupVariable(forNode->plan->counter),
+                evaluate(conditionNode->right, loopEnvironment),
+                evaluate(stepNode->right, loopEnvironment)
+            };
+            for(auto& value : values){
+                if(value->type != ValueType::NumberValue || !static_cast<NumberValue*>(value.get())->isInteger){
+                    return "has a counter, bound or step that is not an integer";
+                }
+            }
+            start = static_cast<NumberValue*>(values[0].get())->integer;
+            int64_t bound = static_cast<NumberValue*>(values[1].get())->integer;
+            step = static_cast<NumberValue*>(values[2].get())->integer;
+            if(stepNode->opCode == '-'){
+                if(step == INT64_MIN){
+                    return "has a step that is too large";
+                }
+                step = -step;
+            }
+            __int128 distance = conditionNode->opCode == '<' ? __int128(bound) - start : __int128(start) - bound;
+            __int128 stride = conditionNode->opCode == '<' ? step : -__int128(step);
+            if(distance <= 0){
+                iterations = 0;
+                return "";
+            }
+            if(stride <= 0){
+                return "does not move its counter towards the bound";
+            }
+            iterations = int64_t((distance + stride - 1) / stride);
+            return "";
+        }
+
+        string reductionIdentities(const ParallelLoopPlan& plan, const shared_ptr<Environment>& loopEnvironment, vector<shared_ptr<R_Value>>& identities){
+            for(auto& reduction : plan.reductions){ //each chunk starts from the neutral element of its reduction
+                shared_ptr<R_Value> value = loopEnvironment->lookupVariable(reduction.name);
+                if(reduction.kind == ReductionKind::Sum && value->type == ValueType::StringValue){
+                    identities.push_back(makeStringValue(""));
+                }else if(value->type != ValueType::NumberValue){
+                    return "combines '" + reduction.name + "' which is not a number";
+                }else if(reduction.kind == ReductionKind::Sum){
+                    identities.push_back(makeIntegerValue(0));
+                }else if(reduction.kind == ReductionKind::Product){
+                    identities.push_back(makeIntegerValue(1));
+                }else{
+                    identities.push_back(value);
+                }
+            }
+            return "";
+        }
+
+        shared_ptr<R_Value> mergeReduction(const Reduction& reduction, const shared_ptr<R_Value>& value, const shared_ptr<R_Value>& partial){
+            if(value->type != partial->type){
+                runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Reduction '", reduction.name, "' changed its type inside the parallel for\n");
+            }
+            if(value->type == ValueType::StringValue){
+                return makeStringValue(string(static_cast<StringValue*>(value.get())->text()) + string(static_cast<StringValue*>(partial.get())->text()));
+            }
+            NumberValue* left = static_cast<NumberValue*>(value.get());
+            NumberValue* right = static_cast<NumberValue*>(partial.get());
+            switch(reduction.kind){
+                case ReductionKind::Sum:
+                    return evaluateCaseNumericBinaryNode('+', left, right);
+                case ReductionKind::Product:
+                    return evaluateCaseNumericBinaryNode('*', left, right);
+                case ReductionKind::Min:
+                    return right->value < left->value ? partial : value;
+                default:
+                    return right->value > left->value ? partial : value;
+            }
+        }
+
 };
 
+inline shared_ptr<R_Value> callScriptFunction(Interpreter& interpreter, const shared_ptr<R_Value>& function, const shared_ptr<R_Value>* arguments, size_t argumentCount){
+    return interpreter.callValue(function, arguments, argumentCount);
+}
 
 
 #endif 
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include "vector"
 #include "string"
 #include "unordered_map"
+#include "istream"
+#include "ExecutionLimits.h"
 
 using namespace std;
 
@@ -15,6 +17,9 @@ enum class TokenArt {
     If,
     Else,
     For,
+    Parallel,
+    Function,
+    Return,
     Number,
     Bool,
     Identifier,
@@ -23,12 +28,16 @@ enum class TokenArt {
     OpenParen, //(
     CloseParen,//)
     OpenBrace,//{
+    OpenDictionary,//#{
     CloseBrace,//}
+    OpenBracket,//[
+    CloseBracket,//]
     Quote,//"
     String,
     Semicolon,//;
     Comma,//,
     Dot,//.
+    Colon,//:
     Greater,//>
     Lesser,//<
     EndOfFile
@@ -40,18 +49,58 @@ inline unordered_map<string, TokenArt> KEYWORDS = { //reserved Keywords
     {"print", TokenArt::Print},
     {"if", TokenArt::If},
     {"else", TokenArt::Else},
-    {"for", TokenArt::For}
+    {"for", TokenArt::For},
+    {"parallel", TokenArt::Parallel},
+    {"function", TokenArt::Function},
+    {"return", TokenArt::Return}
 };
 
 struct Token {
     string value;
     TokenArt art;
+    int line = 0;
+};
+
+struct SyntaxError : ScriptError{
+    int line;
+    SyntaxError(const string& message, int line):ScriptError(message + " ---- Line : " + std::to_string(line) + "\n"), line(line){}
 };
 
 class Lexer{
     private:
         vector<Token> tokens;
         string source;
+        size_t position = 0; //characters before position are consumed
+        int line = 1;
+        istream* input = nullptr; //lines still to be read, nullptr once everything is in source
+
+        bool available(size_t count){ //reads further lines until count characters are left or the input ends
+            while(source.size() - position < count && input != nullptr){
+                string text;
+                if(!getline(*input, text)){
+                    input = nullptr;
+                    break;
+                }
+                if(position > 4096 && 2 * position > source.size()){
+                    source.erase(0, position);
+                    position = 0;
+                }
+                source += text;
+                source += '\n';
+            }
+            return source.size() - position >= count;
+        }
+
+        char peek(size_t offset = 0){
+            return available(offset + 1) ? source[position + offset] : '\0';
+        }
+
+        Token take(size_t length, TokenArt art){
+            Token token = { source.substr(position, length), art, line };
+            position += length;
+            return token;
+        }
+
         bool isAlpha(char c) {
             return isalpha(c);
         }
@@ -66,6 +115,9 @@ class Lexer{
                 case TokenArt::Let: return "LetToken";
                 case TokenArt::Const: return "ConstToken";
                 case TokenArt::Print: return "PrintToken";
+                case TokenArt::Parallel: return "ParallelToken";
+                case TokenArt::Function: return "FunctionToken";
+                case TokenArt::Return: return "ReturnToken";
                 case TokenArt::Number: return "NumberToken";
                 case TokenArt::Identifier: return "IdentifierToken";
                 case TokenArt::BinaryOperator: return "BinaryOperatorToken";
@@ -73,12 +125,16 @@ class Lexer{
                 case TokenArt::OpenParen: return "OpenParenToken";
                 case TokenArt::CloseParen: return "CloseParenToken";
                 case TokenArt::OpenBrace : return "OpenBraceToken";
+                case TokenArt::OpenDictionary : return "OpenDictionaryToken";
                 case TokenArt::CloseBrace : return "CloseBraceToken";
+                case TokenArt::OpenBracket : return "OpenBracketToken";
+                case TokenArt::CloseBracket : return "CloseBracketToken";
                 case TokenArt::Quote: return "QuoteToken";
                 case TokenArt::String: return "StringToken";
                 case TokenArt::Semicolon: return "SemicolonToken";
                 case TokenArt::Comma: return "CommaToken";
                 case TokenArt::Dot: return "DotToken";
+                case TokenArt::Colon: return "ColonToken";
                 case TokenArt::EndOfFile: return "EndOfFileToken";
                 default: return "UnknownToken";
             } 
@@ -87,94 +143,126 @@ class Lexer{
     public:
         Lexer(){}; 
         Lexer(string sourceCode):source(sourceCode){};
-        void setSource(string sourceCode){
-            source=sourceCode;
+        void setSource(string sourceCode, int firstLine = 1){
+            source=move(sourceCode);
+            position = 0;
+            line = firstLine;
+            input = nullptr;
+        }
+        void setInput(istream& stream){
+            source.clear();
+            position = 0;
+            line = 1;
+            input = &stream;
         }
-        vector<Token> tokenize(){
-            
-            while(!source.empty()){
-                if(source[0] == '('){
-                    tokens.push_back({"(",TokenArt::OpenParen});
-                    source.erase(0, 1);
-                }else if (source[0] == ')') {
-                    tokens.push_back({ ")", TokenArt::CloseParen });
-                    source.erase(0, 1);
-                }else if (source[0] == '{') {
-                    tokens.push_back({ "{", TokenArt::OpenBrace  });
-                    source.erase(0, 1);
-                }else if (source[0] == '}') {
-                    tokens.push_back({ "}", TokenArt::CloseBrace });
-                    source.erase(0, 1);
-                }else if (source[0] == '"'){
-                    source.erase(0, 1); 
-                    string strVal = "";
-                    while(!source.empty() && source[0] != '"'){
-                        strVal += source[0];
-                        source.erase(0, 1); 
-                    }
-                    tokens.push_back({ strVal, TokenArt::String});
 
-                    if (!source.empty() && source[0] == '"') {
-                        source.erase(0, 1);
-                    }else{
-                        cerr<<"\n[[Stage]] : Lexing  [[ERROR]] : Unclosed String Literal.\n";
-                        exit(1);
+        Token nextToken(){
+            while (isSpace(peek())) {
+                if (source[position] == '\n') {
+                    line++;
+                }
+                position++;
+            }
+            if (!available(1)) {
+                return { "EOF", TokenArt::EndOfFile, line };
+            }
+            char c = source[position];
+            switch (c) {
+                case '(': return take(1, TokenArt::OpenParen);
+                case ')': return take(1, TokenArt::CloseParen);
+                case '{': return take(1, TokenArt::OpenBrace);
+                case '}': return take(1, TokenArt::CloseBrace);
+                case '[': return take(1, TokenArt::OpenBracket);
+                case ']': return take(1, TokenArt::CloseBracket);
+                case '+': case '-': case '*': case '/': case '%': return take(1, TokenArt::BinaryOperator);
+                case '=': return take(1, TokenArt::Equal);
+                case ';': return take(1, TokenArt::Semicolon);
+                case ',': return take(1, TokenArt::Comma);
+                case '.': return take(1, TokenArt::Dot);
+                case ':': return take(1, TokenArt::Colon);
+                case '>': return take(1, TokenArt::Greater);
+                case '<': return take(1, TokenArt::Lesser);
+                case '#':
+                    if (peek(1) == '{') {
+                        return take(2, TokenArt::OpenDictionary);
                     }
-                }else if (source[0] == '+' || source[0] == '-' || source[0] == '*' || source[0] == '/' || source[0] == '%') {
-                    tokens.push_back({ string(1, source[0]), TokenArt::BinaryOperator });
-                    source.erase(0, 1); 
-                }else if (source[0] == '=') {
-                    tokens.push_back({ "=", TokenArt::Equal });
-                    source.erase(0, 1);
-                }else if (source[0] == ';') {
-                    tokens.push_back({ ";", TokenArt::Semicolon });
-                    source.erase(0, 1); 
-                }else if (source[0] == ',') {
-                    tokens.push_back({ ",", TokenArt::Comma });
-                    source.erase(0, 1); 
-                }else if (source[0] == '.') {
-                    tokens.push_back({ ".", TokenArt::Dot });
-                    source.erase(0, 1); 
-                }else if (source[0] == '>') {
-                    tokens.push_back({ ">", TokenArt::Greater });
-                    source.erase(0, 1); 
-                }else if (source[0] == '<') {
-                    tokens.push_back({ "<", TokenArt::Lesser });
-                    source.erase(0, 1); 
-                }else if (isAlpha(source[0])) {
-                    string identifier = "";
-                    while (!source.empty() && isAlpha(source[0])) {
-                        identifier += source[0];
-                        source.erase(0, 1);
+                    break;
+            }
+            if (c == '"'){
+                size_t length = 1;
+                while (peek(length) != '"' && available(length + 1)) {
+                    length++;
+                }
+                if (!available(length + 1)) {
+                    throw SyntaxError("\n[[Stage]] : Lexing  [[ERROR]] : Unclosed String Literal.", line);
+                }
+                Token token = { "", TokenArt::String, line };
+                token.value.reserve(length - 1);
+                for (size_t i = position + 1; i < position + length; i++) {
+                    if (source[i] == '\n') { //a string may span lines, the line breaks are not part of its value
+                        line++;
+                    } else {
+                        token.value += source[i];
                     }
-                    if (KEYWORDS.find(identifier) != KEYWORDS.end()) {
-                        tokens.push_back({ identifier, KEYWORDS[identifier] }); 
+                }
+                position += length + 1;
+                return token;
+            }
+            if (isAlpha(c)) {
+                size_t length = 1;
+                while (isAlpha(peek(length))) {
+                    length++;
+                }
+                Token token = take(length, TokenArt::Identifier);
+                auto keyword = KEYWORDS.find(token.value);
+                if (keyword != KEYWORDS.end()) {
+                    token.art = keyword->second;
+                }
+                return token;
+            }
+            if (isNum(c)) {
+                size_t length = 1;
+                while (isNum(peek(length))) {
+                    length++;
+                }
+                if (peek(length) == '.' && isNum(peek(length + 1))) {
+                    length++;
+                    while (isNum(peek(length))) {
+                        length++;
                     }
-                    else {
-                        tokens.push_back({ identifier, TokenArt::Identifier });
+                }
+                if (peek(length) == 'e' || peek(length) == 'E') {
+                    size_t exponent = length + 1;
+                    if (peek(exponent) == '+' || peek(exponent) == '-') {
+                        exponent++;
                     }
-                }else if (isNum(source[0])) {
-                    string number = "";
-                    while (!source.empty() && isNum(source[0])) {
-                        number += source[0];
-                        source.erase(0, 1);
+                    if (isNum(peek(exponent))) {
+                        length = exponent;
+                        while (isNum(peek(length))) {
+                            length++;
+                        }
                     }
-                    tokens.push_back({ number, TokenArt::Number });
-                }else if (isSpace(source[0])) {
-                    source.erase(0, 1);
-                }else{
-                    cerr << "\n[[WARNING]] : Invalid character: ' " << source[0] << " ' in sorce code.\n";
-                    source.erase(0, 1);
-                    exit(1);
                 }
+                return take(length, TokenArt::Number);
             }
-            tokens.push_back({ "EOF", TokenArt::EndOfFile });
+            throw SyntaxError("\n[[Stage]] : Lexing  [[ERROR]] : Invalid character: ' " + string(1, c) + " ' in sorce code.", line);
+        }
+
+        vector<Token> tokenize(){
+            tokens.clear();
+            do {
+                tokens.push_back(nextToken());
+            } while (tokens.back().art != TokenArt::EndOfFile);
             return tokens;
         }
 
         void print(){
+            print(tokens);
+        }
+
+        static void print(const vector<Token>& tokens){
             cout<<"\n------------------------ Tokens ------------------------\n ";
-            for(int i = 0; i< tokens.size(); i++){
+            for(size_t i = 0; i< tokens.size(); i++){
                 cout<<"\nType: "<<to_string(tokens[i].art)<<"  ------------  Value: "<<tokens[i].value;
             }
             cout<<"\n\n---------------------------------------------------------\n";
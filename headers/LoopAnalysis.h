@@ -0,0 +1,286 @@
+#ifndef LOOPANALYSIS_H_v1
+#define LOOPANALYSIS_H_v1
+
+#include "AstNodes.h"
+#include "Environment.h"
+#include "Natives.h"
+#include "string"
+#include "vector"
+#include "set"
+
+using namespace std;
+
+enum class ReductionKind{
+    Sum, //x = x + e
+    Product, //x = x * e
+    Min, //x = min(x, e)
+    Max //x = max(x, e)
+};
+
+struct Reduction{
+    string name;
+    ReductionKind kind;
+};
+
+struct ParallelLoopPlan{
+    bool parallel = false;
+    string reason = ""; //why the loop has to run sequentially
+    string counter = "";
+    vector<Reduction> reductions;
+    bool warned = false;
+};
+
+//Decides whether the iterations of a parallel for are independent: the loop has the form
+//for(let i = a; i < b; i = i + c), and the body writes only its own variables and reductions.
+class ParallelLoopAnalysis{
+    private:
+        shared_ptr<Environment> environment;
+        ParallelLoopPlan plan;
+        vector<set<string>> scopes; //variables declared inside the loop body
+        set<string> outerReads;
+
+        void reject(const string& reason){
+            if(plan.reason.empty()){
+                plan.reason = reason;
+            }
+        }
+
+        bool isLocal(const string& name) const{
+            for(auto& scope : scopes){
+                if(scope.count(name) > 0){
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool isIdentifier(const shared_ptr<Expression>& expression, const string& name) const{
+            return expression->node == NodeType::IdentifierNode && static_cast<IdentifierNode*>(expression.get())->value == name;
+        }
+
+        NativeFunction nativeCallee(const shared_ptr<Expression>& callee) const{
+            if(callee->node != NodeType::IdentifierNode || isLocal(static_cast<IdentifierNode*>(callee.get())->value)){
+                return nullptr;
+            }
+            shared_ptr<R_Value> value = environment->findVariable(static_cast<IdentifierNode*>(callee.get())->value);
+            if(value == nullptr || value->type != ValueType::NativeFunctionValue){
+                return nullptr;
+            }
+            return static_cast<NativeFunctionValue*>(value.get())->function;
+        }
+
+        void addReduction(const string& name, ReductionKind kind){
+            for(auto& reduction : plan.reductions){
+                if(reduction.name == name){
+                    if(reduction.kind != kind){
+                        reject("variable '" + name + "' is combined in different ways");
+                    }
+                    return;
+                }
+            }
+            plan.reductions.push_back({name, kind});
+        }
+
+        bool matchReduction(const string& name, const shared_ptr<Expression>& value){
+            if(value->node == NodeType::BinaryNode){
+                BinaryNode* binaryNode = static_cast<BinaryNode*>(value.get());
+                if((binaryNode->opCode == '+' || binaryNode->opCode == '*') && isIdentifier(binaryNode->left, name)){
+                    addReduction(name, binaryNode->opCode == '+' ? ReductionKind::Sum : ReductionKind::Product);
+                    visitExpression(binaryNode->right);
+                    return true;
+                }
+            }else if(value->node == NodeType::CallNode){
+                CallNode* callNode = static_cast<CallNode*>(value.get());
+                NativeFunction function = nativeCallee(callNode->callee);
+                if((function == nativeMin || function == nativeMax) && callNode->arguments.size() == 2){
+                    int own = isIdentifier(callNode->arguments[0], name) ? 0 : isIdentifier(callNode->arguments[1], name) ? 1 : -1;
+                    if(own >= 0){
+                        addReduction(name, function == nativeMin ? ReductionKind::Min : ReductionKind::Max);
+                        visitExpression(callNode->arguments[1 - own]);
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        void visitAssignment(VariableAssignmentNode* assignmentNode){
+            if(assignmentNode->assignmentVariable->node != NodeType::IdentifierNode){
+                reject("assigns object properties");
+                return;
+            }
+            string name = static_cast<IdentifierNode*>(assignmentNode->assignmentVariable.get())->value;
+            if(isLocal(name)){
+                visitExpression(assignmentNode->value);
+            }else if(name == plan.counter){
+                reject("assigns the loop counter '" + name + "'");
+            }else if(!matchReduction(name, assignmentNode->value)){
+                reject("writes variable '" + name + "' declared outside the loop");
+            }
+        }
+
+        void visitBody(const vector<shared_ptr<Statement>>& body){
+            scopes.push_back(set<string>());
+            for(auto& statement : body){
+                visitStatement(statement);
+            }
+            scopes.pop_back();
+        }
+
+        void visitStatement(const shared_ptr<Statement>& statement){
+            switch(statement->node){
+                case NodeType::VariableDeclarationNode:{
+                    VariableDeclarationNode* declarationNode = static_cast<VariableDeclarationNode*>(statement.get());
+                    if(declarationNode->value){
+                        visitExpression(declarationNode->value);
+                    }
+                    scopes.back().insert(declarationNode->name);
+                    break;
+                }
+                case NodeType::PrintNode:
+                    visitExpression(static_cast<PrintNode*>(statement.get())->value);
+                    break;
+                case NodeType::IfNode:{
+                    IfNode* ifNode = static_cast<IfNode*>(statement.get());
+                    visitExpression(ifNode->condition);
+                    visitBody(ifNode->ifBody);
+                    visitBody(ifNode->elseBody);
+                    break;
+                }
+                case NodeType::ForNode:{
+                    ForNode* forNode = static_cast<ForNode*>(statement.get());
+                    scopes.push_back(set<string>());
+                    visitStatement(forNode->initializer);
+                    visitExpression(forNode->condition);
+                    visitStatement(forNode->increment);
+                    visitBody(forNode->forBody);
+                    scopes.pop_back();
+                    break;
+                }
+                case NodeType::FunctionDeclarationNode:
+                    reject("declares a function");
+                    break;
+                case NodeType::ReturnNode:
+                    reject("returns from the loop");
+                    break;
+                default:
+                    visitExpression(static_pointer_cast<Expression>(statement));
+            }
+        }
+
+        void visitExpression(const shared_ptr<Expression>& expression){
+            switch(expression->node){
+                case NodeType::NumberNode:
+                case NodeType::StringNode:
+                    break;
+                case NodeType::IdentifierNode:{
+                    const string& name = static_cast<IdentifierNode*>(expression.get())->value;
+                    if(!isLocal(name)){
+                        outerReads.insert(name);
+                    }
+                    break;
+                }
+                case NodeType::BinaryNode:
+                    visitExpression(static_cast<BinaryNode*>(expression.get())->left);
+                    visitExpression(static_cast<BinaryNode*>(expression.get())->right);
+                    break;
+                case NodeType::ConditionalNode:
+                    visitExpression(static_cast<ConditionalNode*>(expression.get())->left);
+                    visitExpression(static_cast<ConditionalNode*>(expression.get())->right);
+                    break;
+                case NodeType::InvariantNode:
+                    visitExpression(static_cast<InvariantNode*>(expression.get())->expression);
+                    break;
+                case NodeType::VariableAssignmentNode:
+                    visitAssignment(static_cast<VariableAssignmentNode*>(expression.get()));
+                    break;
+                case NodeType::CallNode:{
+                    CallNode* callNode = static_cast<CallNode*>(expression.get());
+                    NativeFunction function = nativeCallee(callNode->callee);
+                    if(function == nullptr){
+                        reject("calls a function that is not native");
+                    }else if(function == nativeSet || function == nativeRemove || function == nativePush || function == nativeSort){
+                        reject("changes a dictionary or an array"); //the chunks would write the same table at once
+                    }else if(function == nativeNext || function == nativeLine || function == nativeField || function == nativeFieldCount || function == nativeFieldNumber || function == nativeClose){
+                        reject("reads a file"); //lines are read in order, chunks would race for the next one
+                    }else if((function == nativeMap || function == nativeFilter) && callNode->arguments.size() == 2 && nativeCallee(callNode->arguments[1]) == nullptr){
+                        reject("passes a function that is not native to " + string(function == nativeMap ? "map" : "filter"));
+                    }
+                    for(auto& argument : callNode->arguments){
+                        visitExpression(argument);
+                    }
+                    break;
+                }
+                case NodeType::DictionaryLiteralNode:
+                    for(auto& entry : static_cast<DictionaryLiteralNode*>(expression.get())->entries){
+                        visitExpression(entry.second);
+                    }
+                    break;
+                case NodeType::ArrayLiteralNode:
+                    for(auto& element : static_cast<ArrayLiteralNode*>(expression.get())->elements){
+                        visitExpression(element);
+                    }
+                    break;
+                case NodeType::ObjectLiteralNode:
+                case NodeType::MemberNode:
+                    reject("uses objects"); //property caches and shapes are shared between threads
+                    break;
+                default:
+                    reject("contains an unsupported expression");
+            }
+        }
+
+        bool readsLoopState(const shared_ptr<Expression>& expression){ //bound and step are evaluated once and must not change
+            set<string> previousReads = outerReads;
+            outerReads.clear();
+            visitExpression(expression);
+            bool reads = outerReads.count(plan.counter) > 0;
+            for(auto& reduction : plan.reductions){
+                reads = reads || outerReads.count(reduction.name) > 0;
+            }
+            outerReads = previousReads;
+            return reads;
+        }
+
+    public:
+        ParallelLoopPlan analyze(ForNode* forNode, const shared_ptr<Environment>& loopEnvironment){
+            environment = loopEnvironment;
+            plan = ParallelLoopPlan();
+            if(forNode->usesFrame){
+                reject("is declared inside a function");
+                return plan;
+            }
+            plan.counter = static_cast<VariableDeclarationNode*>(forNode->initializer.get())->name;
+            ConditionalNode* condition = static_cast<ConditionalNode*>(forNode->condition.get());
+            VariableAssignmentNode* increment = static_cast<VariableAssignmentNode*>(forNode->increment.get());
+            BinaryNode* step = increment->value->node == NodeType::BinaryNode ? static_cast<BinaryNode*>(increment->value.get()) : nullptr;
+            if((condition->opCode != '<' && condition->opCode != '>') || !isIdentifier(condition->left, plan.counter)){
+                reject("has a condition other than counter < bound or counter > bound");
+            }else if(!isIdentifier(increment->assignmentVariable, plan.counter) || step == nullptr || (step->opCode != '+' && step->opCode != '-') || !isIdentifier(step->left, plan.counter)){
+                reject("has an increment other than counter = counter + step or counter = counter - step");
+            }
+            if(!plan.reason.empty()){
+                return plan;
+            }
+
+            visitBody(forNode->forBody);
+            for(auto& reduction : plan.reductions){
+                if(outerReads.count(reduction.name) > 0){
+                    reject("reads the reduction variable '" + reduction.name + "'");
+                }
+                if(environment->findVariable(reduction.name) == nullptr){
+                    reject("writes the undefined variable '" + reduction.name + "'");
+                }else if(environment->isConstant(reduction.name)){
+                    reject("writes the constant '" + reduction.name + "'");
+                }
+            }
+            if(readsLoopState(condition->right) || readsLoopState(step->right)){
+                reject("has a bound or step that changes inside the loop");
+            }
+            plan.parallel = plan.reason.empty();
+            return plan;
+        }
+};
+
+
+#endif
@@ -0,0 +1,359 @@
+#ifndef LOOPINVARIANTS_H_v1
+#define LOOPINVARIANTS_H_v1
+
+#include "AstNodes.h"
+#include "Environment.h"
+#include "Natives.h"
+#include "string"
+#include "vector"
+#include "set"
+
+using namespace std;
+
+//Loop-invariant code motion: arithmetic, concatenations and comparisons in a for loop whose variables
+//are not written anywhere in the loop are replaced by an InvariantNode. The interpreter evaluates it on
+//first use in a run of the loop and reuses the value, so errors and output happen at the same point as before.
+//Loops that call user functions or declare functions are left alone, the called code could write any variable.
+class LoopInvariantMotion{
+    private:
+        shared_ptr<Environment> environment;
+        set<string> declared; //every name declared in the statement, such a name can shadow a native function
+        int slotCount = 0; //slots are numbered per optimized statement, so temporaries do not grow with the programs seen
+
+        int newSlot(){
+            return slotCount++;
+        }
+
+        void collectDeclarations(const shared_ptr<Statement>& statement){
+            switch(statement->node){
+                case NodeType::ProgramNode:
+                    for(auto& child : static_cast<Program*>(statement.get())->statements){
+                        collectDeclarations(child);
+                    }
+                    break;
+                case NodeType::VariableDeclarationNode:
+                    declared.insert(static_cast<VariableDeclarationNode*>(statement.get())->name);
+                    break;
+                case NodeType::IfNode:
+                    for(auto& child : static_cast<IfNode*>(statement.get())->ifBody){
+                        collectDeclarations(child);
+                    }
+                    for(auto& child : static_cast<IfNode*>(statement.get())->elseBody){
+                        collectDeclarations(child);
+                    }
+                    break;
+                case NodeType::ForNode:
+                    collectDeclarations(static_cast<ForNode*>(statement.get())->initializer);
+                    for(auto& child : static_cast<ForNode*>(statement.get())->forBody){
+                        collectDeclarations(child);
+                    }
+                    break;
+                case NodeType::FunctionDeclarationNode:{
+                    FunctionDeclarationNode* functionNode = static_cast<FunctionDeclarationNode*>(statement.get());
+                    declared.insert(functionNode->name);
+                    declared.insert(functionNode->parameters.begin(), functionNode->parameters.end());
+                    for(auto& child : functionNode->body){
+                        collectDeclarations(child);
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+
+        NativeFunctionValue* nativeValue(const shared_ptr<Expression>& expression) const{ //natives are constants of the global scope and write no variables
+            if(expression->node != NodeType::IdentifierNode){
+                return nullptr;
+            }
+            IdentifierNode* identifier = static_cast<IdentifierNode*>(expression.get());
+            if(identifier->slot >= 0 || identifier->capture >= 0 || declared.count(identifier->value) > 0){
+                return nullptr;
+            }
+            shared_ptr<R_Value> value = environment->findVariable(identifier->value);
+            if(value == nullptr || value->type != ValueType::NativeFunctionValue || !environment->isConstant(identifier->value)){
+                return nullptr;
+            }
+            return static_cast<NativeFunctionValue*>(value.get());
+        }
+
+        bool callsNative(CallNode* callNode) const{ //map and filter run the function they are given, it must be native too
+            NativeFunctionValue* native = nativeValue(callNode->callee);
+            if(native == nullptr){
+                return false;
+            }
+            if((native->function == nativeMap || native->function == nativeFilter) && callNode->arguments.size() == 2){
+                return nativeValue(callNode->arguments[1]) != nullptr;
+            }
+            return true;
+        }
+
+        //collects the names a loop writes, false when the loop may run code that writes unknown variables
+        bool collectWrites(Statement* statement, set<string>& written) const{
+            switch(statement->node){
+                case NodeType::VariableDeclarationNode:{
+                    VariableDeclarationNode* declarationNode = static_cast<VariableDeclarationNode*>(statement);
+                    written.insert(declarationNode->name);
+                    return !declarationNode->value || collectWrites(declarationNode->value.get(), written);
+                }
+                case NodeType::PrintNode:
+                    return collectWrites(static_cast<PrintNode*>(statement)->value.get(), written);
+                case NodeType::ReturnNode:
+                    return !static_cast<ReturnNode*>(statement)->value || collectWrites(static_cast<ReturnNode*>(statement)->value.get(), written);
+                case NodeType::IfNode:{
+                    IfNode* ifNode = static_cast<IfNode*>(statement);
+                    bool known = collectWrites(ifNode->condition.get(), written);
+                    for(auto& child : ifNode->ifBody){
+                        known = collectWrites(child.get(), written) && known;
+                    }
+                    for(auto& child : ifNode->elseBody){
+                        known = collectWrites(child.get(), written) && known;
+                    }
+                    return known;
+                }
+                case NodeType::ForNode:{
+                    ForNode* forNode = static_cast<ForNode*>(statement);
+                    bool known = collectWrites(forNode->initializer.get(), written) && collectWrites(forNode->condition.get(), written) && collectWrites(forNode->increment.get(), written);
+                    for(auto& child : forNode->forBody){
+                        known = collectWrites(child.get(), written) && known;
+                    }
+                    return known;
+                }
+                case NodeType::FunctionDeclarationNode:
+                    return false;
+                case NodeType::VariableAssignmentNode:{
+                    VariableAssignmentNode* assignmentNode = static_cast<VariableAssignmentNode*>(statement);
+                    if(assignmentNode->assignmentVariable->node == NodeType::IdentifierNode){
+                        written.insert(static_cast<IdentifierNode*>(assignmentNode->assignmentVariable.get())->value);
+                    }else if(!collectWrites(assignmentNode->assignmentVariable.get(), written)){
+                        return false;
+                    }
+                    return collectWrites(assignmentNode->value.get(), written);
+                }
+                case NodeType::BinaryNode:
+                    return collectWrites(static_cast<BinaryNode*>(statement)->left.get(), written) && collectWrites(static_cast<BinaryNode*>(statement)->right.get(), written);
+                case NodeType::ConditionalNode:
+                    return collectWrites(static_cast<ConditionalNode*>(statement)->left.get(), written) && collectWrites(static_cast<ConditionalNode*>(statement)->right.get(), written);
+                case NodeType::MemberNode:
+                    return collectWrites(static_cast<MemberNode*>(statement)->object.get(), written);
+                case NodeType::ObjectLiteralNode:
+                    for(auto& property : static_cast<ObjectLiteralNode*>(statement)->properties){
+                        if(!collectWrites(property.second.get(), written)){
+                            return false;
+                        }
+                    }
+                    return true;
+                case NodeType::DictionaryLiteralNode:
+                    for(auto& entry : static_cast<DictionaryLiteralNode*>(statement)->entries){
+                        if(!collectWrites(entry.second.get(), written)){
+                            return false;
+                        }
+                    }
+                    return true;
+                case NodeType::ArrayLiteralNode:
+                    for(auto& element : static_cast<ArrayLiteralNode*>(statement)->elements){
+                        if(!collectWrites(element.get(), written)){
+                            return false;
+                        }
+                    }
+                    return true;
+                case NodeType::CallNode:{
+                    CallNode* callNode = static_cast<CallNode*>(statement);
+                    if(!callsNative(callNode)){
+                        return false;
+                    }
+                    for(auto& argument : callNode->arguments){
+                        if(!collectWrites(argument.get(), written)){
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+                case NodeType::InvariantNode:
+                    return collectWrites(static_cast<InvariantNode*>(statement)->expression.get(), written);
+                default:
+                    return true;
+            }
+        }
+
+        static bool isInvariant(const shared_ptr<Expression>& expression, const set<string>& written){
+            switch(expression->node){
+                case NodeType::NumberNode:
+                case NodeType::StringNode:
+                case NodeType::InvariantNode:
+                    return true;
+                case NodeType::IdentifierNode:
+                    return written.count(static_cast<IdentifierNode*>(expression.get())->value) == 0;
+                case NodeType::BinaryNode:
+                    return isInvariant(static_cast<BinaryNode*>(expression.get())->left, written) && isInvariant(static_cast<BinaryNode*>(expression.get())->right, written);
+                case NodeType::ConditionalNode:
+                    return isInvariant(static_cast<ConditionalNode*>(expression.get())->left, written) && isInvariant(static_cast<ConditionalNode*>(expression.get())->right, written);
+                default:
+                    return false; //calls can have effects, objects can change through other variables
+            }
+        }
+
+        void hoist(shared_ptr<Expression>& expression, const set<string>& written, ForNode* loop){ //replaces the largest invariant operations
+            switch(expression->node){
+                case NodeType::BinaryNode:
+                case NodeType::ConditionalNode:
+                    if(isInvariant(expression, written)){
+                        int slot = newSlot();
+                        loop->invariantSlots.push_back(slot);
+                        expression = make_shared<InvariantNode>(expression, slot);
+                    }else if(expression->node == NodeType::BinaryNode){
+                        hoist(static_cast<BinaryNode*>(expression.get())->left, written, loop);
+                        hoist(static_cast<BinaryNode*>(expression.get())->right, written, loop);
+                    }else{
+                        hoist(static_cast<ConditionalNode*>(expression.get())->left, written, loop);
+                        hoist(static_cast<ConditionalNode*>(expression.get())->right, written, loop);
+                    }
+                    break;
+                case NodeType::VariableAssignmentNode:{
+                    VariableAssignmentNode* assignmentNode = static_cast<VariableAssignmentNode*>(expression.get());
+                    if(assignmentNode->assignmentVariable->node == NodeType::MemberNode){
+                        hoist(static_cast<MemberNode*>(assignmentNode->assignmentVariable.get())->object, written, loop);
+                    }
+                    hoist(assignmentNode->value, written, loop);
+                    break;
+                }
+                case NodeType::MemberNode:
+                    hoist(static_cast<MemberNode*>(expression.get())->object, written, loop);
+                    break;
+                case NodeType::ObjectLiteralNode:
+                    for(auto& property : static_cast<ObjectLiteralNode*>(expression.get())->properties){
+                        hoist(property.second, written, loop);
+                    }
+                    break;
+                case NodeType::DictionaryLiteralNode:
+                    for(auto& entry : static_cast<DictionaryLiteralNode*>(expression.get())->entries){
+                        hoist(entry.second, written, loop);
+                    }
+                    break;
+                case NodeType::ArrayLiteralNode:
+                    for(auto& element : static_cast<ArrayLiteralNode*>(expression.get())->elements){
+                        hoist(element, written, loop);
+                    }
+                    break;
+                case NodeType::CallNode:
+                    for(auto& argument : static_cast<CallNode*>(expression.get())->arguments){
+                        hoist(argument, written, loop);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        void hoistStatement(const shared_ptr<Statement>& statement, const set<string>& written, ForNode* loop){
+            switch(statement->node){
+                case NodeType::VariableDeclarationNode:{
+                    VariableDeclarationNode* declarationNode = static_cast<VariableDeclarationNode*>(statement.get());
+                    if(declarationNode->value){
+                        hoist(declarationNode->value, written, loop);
+                    }
+                    break;
+                }
+                case NodeType::PrintNode:
+                    hoist(static_cast<PrintNode*>(statement.get())->value, written, loop);
+                    break;
+                case NodeType::ReturnNode:
+                    if(static_cast<ReturnNode*>(statement.get())->value && !static_cast<ReturnNode*>(statement.get())->tailCall){
+                        hoist(static_cast<ReturnNode*>(statement.get())->value, written, loop);
+                    }
+                    break;
+                case NodeType::IfNode:{
+                    IfNode* ifNode = static_cast<IfNode*>(statement.get());
+                    hoist(ifNode->condition, written, loop);
+                    hoistBody(ifNode->ifBody, written, loop);
+                    hoistBody(ifNode->elseBody, written, loop);
+                    break;
+                }
+                case NodeType::ForNode:
+                    hoistLoopParts(static_cast<ForNode*>(statement.get()), written, loop);
+                    break;
+                case NodeType::FunctionDeclarationNode:
+                    break;
+                default:{
+                    shared_ptr<Expression> expression = static_pointer_cast<Expression>(statement);
+                    hoist(expression, written, loop); //statement level expressions are assignments and calls, they stay in place
+                }
+            }
+        }
+
+        void hoistBody(vector<shared_ptr<Statement>>& body, const set<string>& written, ForNode* loop){
+            for(auto& statement : body){
+                hoistStatement(statement, written, loop);
+            }
+        }
+
+        void hoistLoopParts(ForNode* forNode, const set<string>& written, ForNode* loop){ //the condition node and the increment keep their shape, only operands are replaced
+            hoistStatement(forNode->initializer, written, loop);
+            ConditionalNode* condition = static_cast<ConditionalNode*>(forNode->condition.get());
+            hoist(condition->left, written, loop);
+            hoist(condition->right, written, loop);
+            VariableAssignmentNode* increment = static_cast<VariableAssignmentNode*>(forNode->increment.get());
+            if(increment->value->node == NodeType::BinaryNode){
+                hoist(static_cast<BinaryNode*>(increment->value.get())->right, written, loop);
+            }
+            hoistBody(forNode->forBody, written, loop);
+        }
+
+        void optimizeLoop(ForNode* forNode){
+            set<string> written;
+            if(!collectWrites(forNode, written)){
+                return;
+            }
+            ConditionalNode* condition = static_cast<ConditionalNode*>(forNode->condition.get());
+            hoist(condition->left, written, forNode);
+            hoist(condition->right, written, forNode);
+            hoistBody(forNode->forBody, written, forNode); //the initializer runs once and the increment writes the counter
+        }
+
+        void optimizeStatement(const shared_ptr<Statement>& statement){ //outer loops first, they hoist the most
+            switch(statement->node){
+                case NodeType::ProgramNode:
+                    for(auto& child : static_cast<Program*>(statement.get())->statements){
+                        optimizeStatement(child);
+                    }
+                    break;
+                case NodeType::IfNode:
+                    for(auto& child : static_cast<IfNode*>(statement.get())->ifBody){
+                        optimizeStatement(child);
+                    }
+                    for(auto& child : static_cast<IfNode*>(statement.get())->elseBody){
+                        optimizeStatement(child);
+                    }
+                    break;
+                case NodeType::ForNode:
+                    optimizeLoop(static_cast<ForNode*>(statement.get()));
+                    for(auto& child : static_cast<ForNode*>(statement.get())->forBody){
+                        optimizeStatement(child);
+                    }
+                    break;
+                case NodeType::FunctionDeclarationNode:
+                    for(auto& child : static_cast<FunctionDeclarationNode*>(statement.get())->body){
+                        optimizeStatement(child);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+    public:
+        LoopInvariantMotion(shared_ptr<Environment> environment):environment(environment){}
+
+        void optimize(const shared_ptr<Statement>& statement){ //natives are looked up in the environment the statement runs in
+            declared.clear();
+            slotCount = 0;
+            collectDeclarations(statement);
+            optimizeStatement(statement);
+            if(statement->node == NodeType::ProgramNode){
+                static_cast<Program*>(statement.get())->invariantSlots = slotCount;
+            }
+        }
+};
+
+
+#endif
@@ -0,0 +1,498 @@
+#ifndef NATIVES_H_v1
+#define NATIVES_H_v1
+
+#include "Values.h"
+#include "Environment.h"
+#include "chrono"
+#include "GreenThreads.h"
+#include "ParallelArrays.h"
+#include "InputFile.h"
+#include "StringSearch.h"
+
+using namespace std;
+
+//calls a script or native function from a native, defined after the interpreter
+//arguments must not point into the interpreter's stack, the call can grow it
+inline shared_ptr<R_Value> callScriptFunction(Interpreter& interpreter, const shared_ptr<R_Value>& function, const shared_ptr<R_Value>* arguments, size_t argumentCount);
+
+inline double nativeNumberArgument(const char* functionName, const shared_ptr<R_Value>& argument){
+    if(argument->type != ValueType::NumberValue){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function '", functionName, "' expects number arguments\n");
+    }
+    return static_cast<NumberValue*>(argument.get())->value;
+}
+
+inline shared_ptr<R_Value> nativeAbs(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    return makeNumberValue(fabs(nativeNumberArgument("abs", arguments[0])));
+}
+
+inline shared_ptr<R_Value> nativeFloor(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    return makeNumberValue(floor(nativeNumberArgument("floor", arguments[0])));
+}
+
+inline shared_ptr<R_Value> nativeSqrt(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    return makeNumberValue(sqrt(nativeNumberArgument("sqrt", arguments[0])));
+}
+
+inline ArrayValue* nativeArrayArgument(const char* functionName, const shared_ptr<R_Value>& argument){
+    if(argument->type != ValueType::ArrayValue){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function '", functionName, "' expects an array\n");
+    }
+    return static_cast<ArrayValue*>(argument.get());
+}
+
+inline shared_ptr<R_Value> nativeExtremeOfArray(const char* functionName, const shared_ptr<R_Value>& argument, bool smallest){
+    ArrayValue* array = static_cast<ArrayValue*>(argument.get());
+    if(array->numbers.empty()){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function '", functionName, "' got an empty array\n");
+    }
+    return makeNumberValue(extremeOfArray(array->numbers, smallest));
+}
+
+inline shared_ptr<R_Value> nativeMin(Interpreter&, const shared_ptr<R_Value>* arguments, size_t argumentCount){ //of the arguments or of the numbers of one array
+    if(argumentCount == 1 && arguments[0]->type == ValueType::ArrayValue){
+        return nativeExtremeOfArray("min", arguments[0], true);
+    }
+    if(argumentCount == 0){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function 'min' expects at least one argument\n");
+    }
+    size_t smallest = 0;
+    for(size_t i = 1; i < argumentCount; i++){
+        if(nativeNumberArgument("min", arguments[i]) < nativeNumberArgument("min", arguments[smallest])){
+            smallest = i;
+        }
+    }
+    nativeNumberArgument("min", arguments[smallest]);
+    return arguments[smallest];
+}
+
+inline shared_ptr<R_Value> nativeMax(Interpreter&, const shared_ptr<R_Value>* arguments, size_t argumentCount){
+    if(argumentCount == 1 && arguments[0]->type == ValueType::ArrayValue){
+        return nativeExtremeOfArray("max", arguments[0], false);
+    }
+    if(argumentCount == 0){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function 'max' expects at least one argument\n");
+    }
+    size_t biggest = 0;
+    for(size_t i = 1; i < argumentCount; i++){
+        if(nativeNumberArgument("max", arguments[i]) > nativeNumberArgument("max", arguments[biggest])){
+            biggest = i;
+        }
+    }
+    nativeNumberArgument("max", arguments[biggest]);
+    return arguments[biggest];
+}
+
+inline shared_ptr<R_Value> nativeClock(Interpreter&, const shared_ptr<R_Value>*, size_t){
+    return makeNumberValue(chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline shared_ptr<R_Value> nativeSleep(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //inside a green thread only the calling script waits
+    greenSleep(nativeNumberArgument("sleep", arguments[0]));
+    return makeNullValue();
+}
+
+inline DictionaryValue* nativeDictionaryArgument(const char* functionName, const shared_ptr<R_Value>& argument){
+    if(argument->type != ValueType::DictionaryValue){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function '", functionName, "' expects a dictionary\n");
+    }
+    return static_cast<DictionaryValue*>(argument.get());
+}
+
+inline const string& nativeKeyArgument(const char* functionName, const shared_ptr<R_Value>& argument, string& keyBuffer, size_t& hash){ //numbers are used in their printed form, views are copied to keyBuffer
+    if(argument->type == ValueType::StringValue){
+        StringValue* key = static_cast<StringValue*>(argument.get());
+        if(key->source != nullptr){
+            keyBuffer = key->view;
+            hash = hashKey(keyBuffer);
+            return keyBuffer;
+        }
+        hash = key->interned ? key->hash : hashKey(key->value);
+        return key->value;
+    }
+    if(argument->type != ValueType::NumberValue){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function '", functionName, "' expects a string or number key\n");
+    }
+    keyBuffer = formatNumber(*static_cast<NumberValue*>(argument.get()));
+    hash = hashKey(keyBuffer);
+    return keyBuffer;
+}
+
+inline size_t nativePositionArgument(const char* functionName, const shared_ptr<R_Value>& argument, size_t size){
+    double position = nativeNumberArgument(functionName, argument);
+    if(!(position >= 0 && position < double(size)) || position != floor(position)){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function '", functionName, "' got the position ", position, " outside of 0 to ", size, "\n");
+    }
+    return size_t(position);
+}
+
+inline shared_ptr<R_Value> nativeGet(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //null for missing keys, arrays are indexed from 0
+    if(arguments[0]->type == ValueType::ArrayValue){
+        ArrayValue* array = static_cast<ArrayValue*>(arguments[0].get());
+        return makeNumberValue(array->numbers[nativePositionArgument("get", arguments[1], array->numbers.size())]);
+    }
+    DictionaryValue* dictionary = nativeDictionaryArgument("get", arguments[0]);
+    string keyBuffer;
+    size_t hash;
+    const string& key = nativeKeyArgument("get", arguments[1], keyBuffer, hash);
+    shared_ptr<R_Value> value = dictionary->get(key, hash);
+    return value == nullptr ? makeNullValue() : value;
+}
+
+inline shared_ptr<R_Value> nativeSet(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    if(arguments[0]->type == ValueType::ArrayValue){
+        ArrayValue* array = static_cast<ArrayValue*>(arguments[0].get());
+        array->numbers[nativePositionArgument("set", arguments[1], array->numbers.size())] = nativeNumberArgument("set", arguments[2]);
+        return arguments[2];
+    }
+    DictionaryValue* dictionary = nativeDictionaryArgument("set", arguments[0]);
+    string keyBuffer;
+    size_t hash;
+    const string& key = nativeKeyArgument("set", arguments[1], keyBuffer, hash);
+    dictionary->set(key, hash, arguments[2]);
+    return arguments[2];
+}
+
+inline shared_ptr<R_Value> nativeHas(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    DictionaryValue* dictionary = nativeDictionaryArgument("has", arguments[0]);
+    string keyBuffer;
+    size_t hash;
+    const string& key = nativeKeyArgument("has", arguments[1], keyBuffer, hash);
+    return makeBoolValue(dictionary->entries.contains(key, hash));
+}
+
+inline shared_ptr<R_Value> nativeRemove(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //the last entry moves to the position of the removed one
+    DictionaryValue* dictionary = nativeDictionaryArgument("remove", arguments[0]);
+    string keyBuffer;
+    size_t hash;
+    const string& key = nativeKeyArgument("remove", arguments[1], keyBuffer, hash);
+    return makeBoolValue(dictionary->remove(key, hash));
+}
+
+inline shared_ptr<R_Value> nativeLen(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //strings count bytes
+    if(arguments[0]->type == ValueType::StringValue){
+        return makeIntegerValue(int64_t(static_cast<StringValue*>(arguments[0].get())->text().size()));
+    }
+    if(arguments[0]->type == ValueType::ArrayValue){
+        return makeIntegerValue(int64_t(static_cast<ArrayValue*>(arguments[0].get())->numbers.size()));
+    }
+    return makeIntegerValue(int64_t(nativeDictionaryArgument("len", arguments[0])->entries.size()));
+}
+
+inline shared_ptr<R_Value> nativeKeyAt(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    DictionaryValue* dictionary = nativeDictionaryArgument("keyAt", arguments[0]);
+    return makeStringValue(dictionary->entries.at(nativePositionArgument("keyAt", arguments[1], dictionary->entries.size())).key);
+}
+
+inline shared_ptr<R_Value> nativeValueAt(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    DictionaryValue* dictionary = nativeDictionaryArgument("valueAt", arguments[0]);
+    return dictionary->entries.at(nativePositionArgument("valueAt", arguments[1], dictionary->entries.size())).value;
+}
+
+inline uint64_t maxArrayLength(){ //numbers that fit into the physical memory of the machine
+    static const uint64_t length = []{
+        long pages = sysconf(_SC_PHYS_PAGES), pageSize = sysconf(_SC_PAGESIZE);
+        return pages > 0 && pageSize > 0 ? uint64_t(pages) * uint64_t(pageSize) / sizeof(double) : uint64_t(4294967295);
+    }();
+    return length;
+}
+
+inline size_t nativeCount(const char* functionName, double count){ //length of a new array, checked before anything is allocated
+    if(!(count >= 0 && count <= double(maxArrayLength())) || count != floor(count)){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function '", functionName, "' expects a count from 0 to ", maxArrayLength(), ", got ", count, "\n");
+    }
+    return size_t(count);
+}
+
+inline shared_ptr<R_Value> nativeArray(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //count copies of a number
+    size_t count = nativeCount("array", nativeNumberArgument("array", arguments[0]));
+    reserveMemory(int64_t(count * sizeof(double)));
+    return makeArrayValue(vector<double>(count, nativeNumberArgument("array", arguments[1])));
+}
+
+inline shared_ptr<R_Value> nativeRange(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //start, start + 1, ... up to end without it
+    double start = nativeNumberArgument("range", arguments[0]);
+    double end = nativeNumberArgument("range", arguments[1]);
+    size_t count = end > start ? nativeCount("range", ceil(end - start)) : 0;
+    reserveMemory(int64_t(count * sizeof(double)));
+    vector<double> numbers(count);
+    for(size_t i = 0; i < numbers.size(); i++){
+        numbers[i] = start + double(i);
+    }
+    return makeArrayValue(move(numbers));
+}
+
+inline shared_ptr<R_Value> nativePush(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    nativeArrayArgument("push", arguments[0])->push(nativeNumberArgument("push", arguments[1]));
+    return arguments[1];
+}
+
+inline shared_ptr<R_Value> nativeSort(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //in place, ascending
+    ArrayValue* array = nativeArrayArgument("sort", arguments[0]);
+    sortArray(array->numbers);
+    array->charged();
+    return arguments[0];
+}
+
+inline shared_ptr<R_Value> nativeSumOf(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    return makeNumberValue(sumArray(nativeArrayArgument("sumOf", arguments[0])->numbers));
+}
+
+//map and filter compile the function to a kernel when they can, other functions are called once per number
+inline bool nativeKernel(const char* functionName, const shared_ptr<R_Value>& function, NumericKernel& kernel){
+    bool takesOne = function->type == ValueType::FunctionValue ? static_cast<FunctionValue*>(function.get())->declaration->parameters.size() == 1
+        : function->type == ValueType::NativeFunctionValue && (static_cast<NativeFunctionValue*>(function.get())->arity == 1 || static_cast<NativeFunctionValue*>(function.get())->arity == -1);
+    if(!takesOne){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function '", functionName, "' expects a function of one argument\n");
+    }
+    return KernelCompiler().compile(function, kernel);
+}
+
+inline shared_ptr<R_Value> nativeMap(Interpreter& interpreter, const shared_ptr<R_Value>* arguments, size_t){ //a new array of the function's results
+    shared_ptr<R_Value> array = arguments[0], function = arguments[1];
+    ArrayValue* source = nativeArrayArgument("map", array);
+    NumericKernel kernel;
+    if(nativeKernel("map", function, kernel) && !kernel.returnsBool){
+        reserveMemory(int64_t(source->numbers.size() * sizeof(double)));
+        return makeArrayValue(mapArray(source->numbers, kernel));
+    }
+    shared_ptr<ArrayValue> mapped = makeArrayValue();
+    for(size_t i = 0; i < source->numbers.size(); i++){ //the function may push to the array it is mapped over
+        shared_ptr<R_Value> number = makeNumberValue(source->numbers[i]);
+        mapped->push(nativeNumberArgument("map", callScriptFunction(interpreter, function, &number, 1)));
+    }
+    return mapped;
+}
+
+inline shared_ptr<R_Value> nativeFilter(Interpreter& interpreter, const shared_ptr<R_Value>* arguments, size_t){ //a new array of the numbers the function returns true for
+    shared_ptr<R_Value> array = arguments[0], function = arguments[1];
+    ArrayValue* source = nativeArrayArgument("filter", array);
+    NumericKernel kernel;
+    if(nativeKernel("filter", function, kernel) && kernel.returnsBool){
+        reserveMemory(int64_t(source->numbers.size() * sizeof(double)));
+        return makeArrayValue(filterArray(source->numbers, kernel));
+    }
+    shared_ptr<ArrayValue> filtered = makeArrayValue();
+    for(size_t i = 0; i < source->numbers.size(); i++){
+        shared_ptr<R_Value> number = makeNumberValue(source->numbers[i]);
+        shared_ptr<R_Value> keep = callScriptFunction(interpreter, function, &number, 1);
+        if(keep->type != ValueType::BoolValue){
+            runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function 'filter' expects the function to return true or false\n");
+        }
+        if(static_cast<BoolValue*>(keep.get())->value){
+            filtered->push(static_cast<NumberValue*>(number.get())->value);
+        }
+    }
+    return filtered;
+}
+
+inline string_view nativeStringArgument(const char* functionName, const shared_ptr<R_Value>& argument){
+    if(argument->type != ValueType::StringValue){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function '", functionName, "' expects a string\n");
+    }
+    return static_cast<StringValue*>(argument.get())->text();
+}
+
+inline FileValue* nativeFileArgument(const char* functionName, const shared_ptr<R_Value>& argument){
+    if(argument->type != ValueType::FileValue){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function '", functionName, "' expects a file\n");
+    }
+    return static_cast<FileValue*>(argument.get());
+}
+
+inline FileValue* nativeLineArgument(const char* functionName, const shared_ptr<R_Value>& argument){ //a file positioned on a line
+    FileValue* file = nativeFileArgument(functionName, argument);
+    if(!file->file.hasLine()){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function '", functionName, "' needs a line, call next on '", file->path, "' first and check that it returns true\n");
+    }
+    return file;
+}
+
+inline shared_ptr<R_Value> nativeOpen(Interpreter&, const shared_ptr<R_Value>* arguments, size_t argumentCount){ //path and an optional one character field delimiter, "-" is standard input
+    if(argumentCount != 1 && argumentCount != 2){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function 'open' expects a path and optionally a delimiter\n");
+    }
+    string path(nativeStringArgument("open", arguments[0]));
+    char delimiter = ',';
+    if(argumentCount == 2){
+        string_view text = nativeStringArgument("open", arguments[1]);
+        if(text.size() != 1){
+            runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function 'open' expects a delimiter of one character\n");
+        }
+        delimiter = text[0];
+    }
+    shared_ptr<FileValue> file = make_shared<FileValue>(path);
+    if(!file->file.open(path, delimiter)){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function 'open' could not open '", path, "' : ", strerror(errno), "\n");
+    }
+    return file;
+}
+
+inline shared_ptr<R_Value> nativeNext(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //moves to the next line, false at the end
+    return makeBoolValue(nativeFileArgument("next", arguments[0])->file.next());
+}
+
+inline shared_ptr<R_Value> nativeLine(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    InputFile& file = nativeLineArgument("line", arguments[0])->file;
+    return makeStringView(file.line(), file.source());
+}
+
+inline shared_ptr<R_Value> nativeFieldCount(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    return makeIntegerValue(int64_t(nativeLineArgument("fieldCount", arguments[0])->file.splitFields().size()));
+}
+
+inline shared_ptr<R_Value> nativeField(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //fields are indexed from 0
+    InputFile& file = nativeLineArgument("field", arguments[0])->file;
+    const vector<string_view>& fields = file.splitFields();
+    return makeStringView(fields[nativePositionArgument("field", arguments[1], fields.size())], file.source());
+}
+
+inline shared_ptr<R_Value> nativeNumberText(const char* functionName, string_view text){
+    shared_ptr<R_Value> number = parseNumberText(text);
+    if(number == nullptr){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function '", functionName, "' expects a number, got '", text, "'\n");
+    }
+    return number;
+}
+
+inline shared_ptr<R_Value> nativeFieldNumber(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //parses the field without making a string of it
+    const vector<string_view>& fields = nativeLineArgument("fieldNumber", arguments[0])->file.splitFields();
+    return nativeNumberText("fieldNumber", fields[nativePositionArgument("fieldNumber", arguments[1], fields.size())]);
+}
+
+inline shared_ptr<R_Value> nativeParseNumber(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    return nativeNumberText("parseNumber", nativeStringArgument("parseNumber", arguments[0]));
+}
+
+inline shared_ptr<R_Value> nativeClose(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //lines and fields read before stay usable
+    nativeFileArgument("close", arguments[0])->file.close();
+    return makeNullValue();
+}
+
+inline shared_ptr<R_Value> nativeSubstring(const shared_ptr<R_Value>& text, string_view part){ //a view of part of the string, which keeps the string's memory alive
+    StringValue* whole = static_cast<StringValue*>(text.get());
+    return makeStringView(part, whole->source != nullptr ? whole->source : shared_ptr<const void>(text));
+}
+
+inline shared_ptr<R_Value> nativeFind(Interpreter&, const shared_ptr<R_Value>* arguments, size_t argumentCount){ //position of the first occurrence at or after an optional start, -1 if there is none
+    if(argumentCount != 2 && argumentCount != 3){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function 'find' expects a string, the text to find and optionally a start\n");
+    }
+    string_view text = nativeStringArgument("find", arguments[0]);
+    string_view needle = nativeStringArgument("find", arguments[1]);
+    size_t from = argumentCount == 3 ? nativePositionArgument("find", arguments[2], text.size() + 1) : 0;
+    size_t position = findText(text, needle, from);
+    return makeIntegerValue(position == textNotFound ? -1 : int64_t(position));
+}
+
+inline shared_ptr<R_Value> nativeSplit(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //a dictionary of the parts by their position, the parts are views of the string
+    string_view text = nativeStringArgument("split", arguments[0]);
+    string_view delimiter = nativeStringArgument("split", arguments[1]);
+    if(delimiter.empty()){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function 'split' expects a delimiter that is not empty\n");
+    }
+    shared_ptr<DictionaryValue> parts = makeDictionaryValue();
+    size_t start = 0;
+    for(int64_t index = 0;; index++){
+        size_t end = findText(text, delimiter, start);
+        string key = to_string(index); //the printed form get uses for number keys
+        parts->set(key, hashKey(key), nativeSubstring(arguments[0], text.substr(start, end == textNotFound ? textNotFound : end - start)));
+        if(end == textNotFound){
+            break;
+        }
+        start = end + delimiter.size();
+    }
+    return parts;
+}
+
+inline shared_ptr<R_Value> nativeReplace(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //every occurrence, the string itself when there is none
+    string_view text = nativeStringArgument("replace", arguments[0]);
+    string_view pattern = nativeStringArgument("replace", arguments[1]);
+    string_view replacement = nativeStringArgument("replace", arguments[2]);
+    size_t position = pattern.empty() ? textNotFound : findText(text, pattern);
+    if(position == textNotFound){
+        return arguments[0];
+    }
+    string result;
+    reserveMemory(int64_t(text.size()));
+    result.reserve(text.size());
+    size_t start = 0;
+    for(; position != textNotFound; position = findText(text, pattern, start)){
+        if(result.size() + (position - start) + replacement.size() > result.capacity()){ //the string is about to grow to twice its capacity
+            reserveMemory(int64_t(2 * result.capacity() + (position - start) + replacement.size()));
+        }
+        result.append(text.data() + start, position - start);
+        result.append(replacement);
+        start = position + pattern.size();
+    }
+    result.append(text.substr(start));
+    return makeStringValue(move(result));
+}
+
+inline shared_ptr<R_Value> nativeStartsWith(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    string_view text = nativeStringArgument("startsWith", arguments[0]);
+    string_view prefix = nativeStringArgument("startsWith", arguments[1]);
+    return makeBoolValue(text.substr(0, prefix.size()) == prefix);
+}
+
+inline shared_ptr<R_Value> nativeEndsWith(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){
+    string_view text = nativeStringArgument("endsWith", arguments[0]);
+    string_view suffix = nativeStringArgument("endsWith", arguments[1]);
+    return makeBoolValue(text.size() >= suffix.size() && text.substr(text.size() - suffix.size()) == suffix);
+}
+
+inline shared_ptr<R_Value> nativeCompareIgnoreCase(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //-1, 0 or 1
+    return makeIntegerValue(compareIgnoreCase(nativeStringArgument("compareIgnoreCase", arguments[0]), nativeStringArgument("compareIgnoreCase", arguments[1])));
+}
+
+inline shared_ptr<R_Value> nativeSlice(Interpreter&, const shared_ptr<R_Value>* arguments, size_t){ //from start up to end without it, a view of the string
+    string_view text = nativeStringArgument("slice", arguments[0]);
+    size_t start = nativePositionArgument("slice", arguments[1], text.size() + 1);
+    size_t end = nativePositionArgument("slice", arguments[2], text.size() + 1);
+    if(end < start){
+        runtimeError("\n[[Stage]] : Interpreting  [[ERROR]] : Native function 'slice' expects the end ", end, " not to be before the start ", start, "\n");
+    }
+    return nativeSubstring(arguments[0], text.substr(start, end - start));
+}
+
+inline void registerNativeFunctions(shared_ptr<Environment> environment){
+    environment->defineNativeFunction("abs", 1, nativeAbs);
+    environment->defineNativeFunction("floor", 1, nativeFloor);
+    environment->defineNativeFunction("sqrt", 1, nativeSqrt);
+    environment->defineNativeFunction("min", -1, nativeMin);
+    environment->defineNativeFunction("max", -1, nativeMax);
+    environment->defineNativeFunction("clock", 0, nativeClock);
+    environment->defineNativeFunction("sleep", 1, nativeSleep);
+    environment->defineNativeFunction("get", 2, nativeGet);
+    environment->defineNativeFunction("set", 3, nativeSet);
+    environment->defineNativeFunction("has", 2, nativeHas);
+    environment->defineNativeFunction("remove", 2, nativeRemove);
+    environment->defineNativeFunction("len", 1, nativeLen);
+    environment->defineNativeFunction("keyAt", 2, nativeKeyAt);
+    environment->defineNativeFunction("valueAt", 2, nativeValueAt);
+    environment->defineNativeFunction("array", 2, nativeArray);
+    environment->defineNativeFunction("range", 2, nativeRange);
+    environment->defineNativeFunction("push", 2, nativePush);
+    environment->defineNativeFunction("sort", 1, nativeSort);
+    environment->defineNativeFunction("sumOf", 1, nativeSumOf);
+    environment->defineNativeFunction("map", 2, nativeMap);
+    environment->defineNativeFunction("filter", 2, nativeFilter);
+    environment->defineNativeFunction("open", -1, nativeOpen);
+    environment->defineNativeFunction("next", 1, nativeNext);
+    environment->defineNativeFunction("line", 1, nativeLine);
+    environment->defineNativeFunction("fieldCount", 1, nativeFieldCount);
+    environment->defineNativeFunction("field", 2, nativeField);
+    environment->defineNativeFunction("fieldNumber", 2, nativeFieldNumber);
+    environment->defineNativeFunction("parseNumber", 1, nativeParseNumber);
+    environment->defineNativeFunction("close", 1, nativeClose);
+    environment->defineNativeFunction("find", -1, nativeFind);
+    environment->defineNativeFunction("split", 2, nativeSplit);
+    environment->defineNativeFunction("replace", 3, nativeReplace);
+    environment->defineNativeFunction("startsWith", 2, nativeStartsWith);
+    environment->defineNativeFunction("endsWith", 2, nativeEndsWith);
+    environment->defineNativeFunction("compareIgnoreCase", 2, nativeCompareIgnoreCase);
+    environment->defineNativeFunction("slice", 3, nativeSlice);
+}
+
+
+#endif
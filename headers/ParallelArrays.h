@@ -0,0 +1,419 @@
+#ifndef PARALLEL_ARRAYS_H_v1
+#define PARALLEL_ARRAYS_H_v1
+
+#include "vector"
+#include "string"
+#include "algorithm"
+#include "cmath"
+#include "future"
+#include "Values.h"
+#include "AstNodes.h"
+#include "Environment.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+/*
+    Bulk operations on the numbers of an array.
+    Arrays are cut into blocks of a fixed size, every block is one unit of work on the thread pool.
+    Results are combined in block order, so a sum or a filter gives the same result on any number of threads.
+    Arrays of a single block and calls from pool workers (a parallel for) run on the calling thread.
+*/
+
+constexpr size_t arrayBlockSize = 1 << 16;
+
+inline size_t arrayBlockCount(size_t count){
+    return max<size_t>(1, (count + arrayBlockSize - 1) / arrayBlockSize);
+}
+
+template<typename Body>
+void forEachArrayBlock(size_t count, Body body){ //body(block, begin, end) for every block of count elements
+    size_t blocks = arrayBlockCount(count);
+    if(blocks == 1 || threadPool().size() == 1 || onPoolThread()){
+        for(size_t block = 0; block < blocks; block++){
+            body(block, block * arrayBlockSize, min(count, (block + 1) * arrayBlockSize));
+        }
+        return;
+    }
+    size_t taskCount = min(blocks, threadPool().size() * 4);
+    vector<future<void>> tasks;
+    for(size_t task = 0; task < taskCount; task++){
+        size_t first = blocks * task / taskCount;
+        size_t last = blocks * (task + 1) / taskCount;
+        tasks.push_back(threadPool().submit([&body, first, last, count]{
+            for(size_t block = first; block < last; block++){
+                body(block, block * arrayBlockSize, min(count, (block + 1) * arrayBlockSize));
+            }
+        }));
+    }
+    for(auto& task : tasks){
+        task.get();
+    }
+}
+
+inline double sumArray(const vector<double>& numbers){
+    vector<double> partial(arrayBlockCount(numbers.size()), 0.0);
+    forEachArrayBlock(numbers.size(), [&](size_t block, size_t begin, size_t end){
+        double lanes[4] = {0, 0, 0, 0}; //independent additions, the compiler keeps them in one vector register
+        size_t i = begin;
+        for(; i + 4 <= end; i += 4){
+            for(int lane = 0; lane < 4; lane++){
+                lanes[lane] += numbers[i + lane];
+            }
+        }
+        for(; i < end; i++){
+            lanes[0] += numbers[i];
+        }
+        partial[block] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    });
+    double sum = 0;
+    for(double blockSum : partial){
+        sum += blockSum;
+    }
+    return sum;
+}
+
+inline double extremeOfArray(const vector<double>& numbers, bool smallest){ //the first number no later one is smaller (or bigger) than, like min and max over arguments
+    vector<double> partial(arrayBlockCount(numbers.size()));
+    forEachArrayBlock(numbers.size(), [&](size_t block, size_t begin, size_t end){
+        double extreme = numbers[begin];
+        for(size_t i = begin + 1; i < end; i++){
+            extreme = (smallest ? numbers[i] < extreme : numbers[i] > extreme) ? numbers[i] : extreme;
+        }
+        partial[block] = extreme;
+    });
+    double extreme = partial[0];
+    for(double blockExtreme : partial){
+        extreme = (smallest ? blockExtreme < extreme : blockExtreme > extreme) ? blockExtreme : extreme;
+    }
+    return extreme;
+}
+
+inline void sortArray(vector<double>& numbers){ //ascending with NaN at the end; every thread sorts one part, then neighbouring parts are merged pairwise
+    size_t count = partition(numbers.begin(), numbers.end(), [](double number){ return number == number; }) - numbers.begin();
+    size_t parts = 1;
+    while(parts < threadPool().size()){
+        parts *= 2;
+    }
+    if(parts == 1 || count < 2 * arrayBlockSize || onPoolThread()){
+        sort(numbers.begin(), numbers.begin() + count);
+        return;
+    }
+    vector<size_t> bounds(parts + 1);
+    for(size_t part = 0; part <= parts; part++){
+        bounds[part] = count * part / parts;
+    }
+    vector<future<void>> tasks;
+    for(size_t part = 0; part < parts; part++){
+        tasks.push_back(threadPool().submit([&numbers, &bounds, part]{
+            sort(numbers.begin() + bounds[part], numbers.begin() + bounds[part + 1]);
+        }));
+    }
+    for(auto& task : tasks){
+        task.get();
+    }
+    vector<double> merged(numbers.size());
+    copy(numbers.begin() + count, numbers.end(), merged.begin() + count);
+    for(size_t width = 1; width < parts; width *= 2){
+        tasks.clear();
+        for(size_t first = 0; first < parts; first += 2 * width){
+            tasks.push_back(threadPool().submit([&numbers, &merged, &bounds, first, width]{
+                size_t begin = bounds[first], middle = bounds[first + width], end = bounds[first + 2 * width];
+                merge(numbers.begin() + begin, numbers.begin() + middle, numbers.begin() + middle, numbers.begin() + end, merged.begin() + begin);
+            }));
+        }
+        for(auto& task : tasks){
+            task.get();
+        }
+        numbers.swap(merged);
+    }
+}
+
+//A script function of one number whose body only returns arithmetic of its parameter and of constants,
+//compiled to postfix operations that run over blocks of numbers instead of one value at a time.
+struct NumericKernel{
+    enum Op : uint8_t{ Parameter, Constant, Add, Subtract, Multiply, Divide, Modulo, Abs, Floor, Sqrt, Min, Max, Less, Greater, Equal, Select };
+    struct Instruction{
+        Op op;
+        double constant = 0;
+    };
+
+    static constexpr size_t lanes = 256; //numbers every operation handles at once
+
+    vector<Instruction> program;
+    int depth = 0; //operand blocks on the stack at most
+    bool returnsBool = false;
+
+    void run(const double* input, double* output, size_t count) const{
+        vector<double> stack(size_t(depth) * lanes);
+        for(size_t offset = 0; offset < count; offset += lanes){
+            size_t n = min(lanes, count - offset);
+            size_t height = 0; //operand blocks on the stack
+            for(const Instruction& instruction : program){
+                if(instruction.op == Parameter || instruction.op == Constant){
+                    double* pushed = stack.data() + height++ * lanes;
+                    if(instruction.op == Parameter){
+                        copy(input + offset, input + offset + n, pushed);
+                    }else{
+                        fill(pushed, pushed + n, instruction.constant);
+                    }
+                    continue;
+                }
+                double* top = stack.data() + (height - 1) * lanes;
+                double* left = height > 1 ? top - lanes : top; //unary operations only use top
+                switch(instruction.op){
+                    case Add: for(size_t i = 0; i < n; i++) left[i] += top[i]; break;
+                    case Subtract: for(size_t i = 0; i < n; i++) left[i] -= top[i]; break;
+                    case Multiply: for(size_t i = 0; i < n; i++) left[i] *= top[i]; break;
+                    case Divide: for(size_t i = 0; i < n; i++) left[i] /= top[i]; break;
+                    case Modulo: for(size_t i = 0; i < n; i++) left[i] = fmod(left[i], top[i]); break;
+                    case Min: for(size_t i = 0; i < n; i++) left[i] = top[i] < left[i] ? top[i] : left[i]; break;
+                    case Max: for(size_t i = 0; i < n; i++) left[i] = top[i] > left[i] ? top[i] : left[i]; break;
+                    case Less: for(size_t i = 0; i < n; i++) left[i] = left[i] < top[i]; break;
+                    case Greater: for(size_t i = 0; i < n; i++) left[i] = left[i] > top[i]; break;
+                    case Equal: for(size_t i = 0; i < n; i++) left[i] = left[i] == top[i]; break;
+                    case Abs: for(size_t i = 0; i < n; i++) top[i] = fabs(top[i]); break;
+                    case Floor: for(size_t i = 0; i < n; i++) top[i] = floor(top[i]); break;
+                    case Sqrt: for(size_t i = 0; i < n; i++) top[i] = sqrt(top[i]); break;
+                    case Select:{ //condition, then, else
+                        double* condition = left - lanes;
+                        for(size_t i = 0; i < n; i++){
+                            condition[i] = condition[i] != 0 ? left[i] : top[i];
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+                height -= instruction.op == Select ? 2 : instruction.op == Abs || instruction.op == Floor || instruction.op == Sqrt ? 0 : 1;
+            }
+            copy(stack.data(), stack.data() + n, output + offset); //the result is the only block left
+        }
+    }
+};
+
+class KernelCompiler{
+    private:
+        enum class Result{ Failed, Number, Bool };
+
+        static const size_t maxInstructions = 4096; //if statements copy the code after them into both branches
+
+        FunctionValue* function = nullptr;
+        NumericKernel kernel;
+        int depth = 0;
+
+        void emit(NumericKernel::Op op, double constant = 0){
+            kernel.program.push_back({op, constant});
+            if(op == NumericKernel::Parameter || op == NumericKernel::Constant){
+                kernel.depth = max(kernel.depth, ++depth);
+            }else if(op == NumericKernel::Select){
+                depth -= 2;
+            }else if(op != NumericKernel::Abs && op != NumericKernel::Floor && op != NumericKernel::Sqrt){
+                depth--;
+            }
+        }
+
+        Result emitConstant(const shared_ptr<R_Value>& value){
+            if(value != nullptr && value->type == ValueType::NumberValue){
+                emit(NumericKernel::Constant, static_cast<NumberValue*>(value.get())->value);
+                return Result::Number;
+            }
+            if(value != nullptr && value->type == ValueType::BoolValue){
+                emit(NumericKernel::Constant, static_cast<BoolValue*>(value.get())->value ? 1 : 0);
+                return Result::Bool;
+            }
+            return Result::Failed;
+        }
+
+        shared_ptr<R_Value> lookup(IdentifierNode* identifier) const{ //variables outside of the function, they cannot change while the kernel runs
+            if(identifier->capture >= 0){
+                return function->captures[identifier->capture];
+            }
+            return function->closure->findVariable(identifier->value);
+        }
+
+        Result compileCall(CallNode* callNode){
+            if(callNode->callee->node != NodeType::IdentifierNode || static_cast<IdentifierNode*>(callNode->callee.get())->slot >= 0){
+                return Result::Failed;
+            }
+            shared_ptr<R_Value> callee = lookup(static_cast<IdentifierNode*>(callNode->callee.get()));
+            if(callee == nullptr || callee->type != ValueType::NativeFunctionValue || callNode->arguments.empty()){
+                return Result::Failed;
+            }
+            const string& name = static_cast<NativeFunctionValue*>(callee.get())->name;
+            if(name != "abs" && name != "floor" && name != "sqrt" && name != "min" && name != "max"){
+                return Result::Failed;
+            }
+            if((name == "abs" || name == "floor" || name == "sqrt") && callNode->arguments.size() != 1){
+                return Result::Failed;
+            }
+            for(size_t i = 0; i < callNode->arguments.size(); i++){
+                if(compileExpression(callNode->arguments[i]) != Result::Number){
+                    return Result::Failed;
+                }
+                if(i > 0){
+                    emit(name == "min" ? NumericKernel::Min : NumericKernel::Max);
+                }
+            }
+            if(name == "abs" || name == "floor" || name == "sqrt"){
+                emit(name == "abs" ? NumericKernel::Abs : name == "floor" ? NumericKernel::Floor : NumericKernel::Sqrt);
+            }
+            return Result::Number;
+        }
+
+        Result compileExpression(const shared_ptr<Expression>& expression){
+            if(kernel.program.size() > maxInstructions){
+                return Result::Failed;
+            }
+            switch(expression->node){
+                case NodeType::NumberNode:
+                    emit(NumericKernel::Constant, static_cast<NumberNode*>(expression.get())->value);
+                    return Result::Number;
+                case NodeType::IdentifierNode:{
+                    IdentifierNode* identifier = static_cast<IdentifierNode*>(expression.get());
+                    if(identifier->slot == 0){
+                        emit(NumericKernel::Parameter);
+                        return Result::Number;
+                    }
+                    return identifier->slot > 0 ? Result::Failed : emitConstant(lookup(identifier));
+                }
+                case NodeType::InvariantNode:
+                    return compileExpression(static_cast<InvariantNode*>(expression.get())->expression);
+                case NodeType::BinaryNode:{
+                    BinaryNode* binaryNode = static_cast<BinaryNode*>(expression.get());
+                    if(compileExpression(binaryNode->left) != Result::Number || compileExpression(binaryNode->right) != Result::Number){
+                        return Result::Failed;
+                    }
+                    switch(binaryNode->opCode){
+                        case '+': emit(NumericKernel::Add); break;
+                        case '-': emit(NumericKernel::Subtract); break;
+                        case '*': emit(NumericKernel::Multiply); break;
+                        case '/': emit(NumericKernel::Divide); break;
+                        case '%':{ //only by a constant, a zero divisor is an error the kernel cannot report
+                            const NumericKernel::Instruction& divisor = kernel.program.back();
+                            if(divisor.op != NumericKernel::Constant || divisor.constant == 0){
+                                return Result::Failed;
+                            }
+                            emit(NumericKernel::Modulo);
+                            break;
+                        }
+                        default:
+                            return Result::Failed;
+                    }
+                    return Result::Number;
+                }
+                case NodeType::ConditionalNode:{
+                    ConditionalNode* conditionalNode = static_cast<ConditionalNode*>(expression.get());
+                    Result left = compileExpression(conditionalNode->left);
+                    Result right = compileExpression(conditionalNode->right);
+                    if(left == Result::Failed || left != right || (left == Result::Bool && conditionalNode->opCode != '=')){
+                        return Result::Failed;
+                    }
+                    emit(conditionalNode->opCode == '<' ? NumericKernel::Less : conditionalNode->opCode == '>' ? NumericKernel::Greater : NumericKernel::Equal);
+                    return Result::Bool;
+                }
+                case NodeType::CallNode:
+                    return compileCall(static_cast<CallNode*>(expression.get()));
+                default:
+                    return Result::Failed;
+            }
+        }
+
+        Result compileStatements(const vector<Statement*>& statements){ //the value the function returns when it runs these statements
+            if(statements.empty() || kernel.program.size() > maxInstructions){
+                return Result::Failed; //falling off the end returns null
+            }
+            Statement* statement = statements.front();
+            if(statement->node == NodeType::ReturnNode){
+                ReturnNode* returnNode = static_cast<ReturnNode*>(statement);
+                return returnNode->value ? compileExpression(returnNode->value) : Result::Failed;
+            }
+            if(statement->node != NodeType::IfNode){
+                return Result::Failed;
+            }
+            IfNode* ifNode = static_cast<IfNode*>(statement);
+            if(compileExpression(ifNode->condition) != Result::Bool){
+                return Result::Failed;
+            }
+            vector<Statement*> thenStatements, elseStatements;
+            for(auto& child : ifNode->ifBody){
+                thenStatements.push_back(child.get());
+            }
+            for(auto& child : ifNode->elseBody){
+                elseStatements.push_back(child.get());
+            }
+            thenStatements.insert(thenStatements.end(), statements.begin() + 1, statements.end());
+            elseStatements.insert(elseStatements.end(), statements.begin() + 1, statements.end());
+            Result thenResult = compileStatements(thenStatements);
+            if(thenResult == Result::Failed || compileStatements(elseStatements) != thenResult){
+                return Result::Failed;
+            }
+            emit(NumericKernel::Select);
+            return thenResult;
+        }
+
+    public:
+        //false when the function does something a kernel cannot, it is then called through the interpreter
+        bool compile(const shared_ptr<R_Value>& callee, NumericKernel& compiled){
+            kernel = NumericKernel();
+            depth = 0;
+            Result result = Result::Failed;
+            if(callee->type == ValueType::NativeFunctionValue){
+                const string& name = static_cast<NativeFunctionValue*>(callee.get())->name;
+                if(name == "abs" || name == "floor" || name == "sqrt" || name == "min" || name == "max"){
+                    emit(NumericKernel::Parameter);
+                    if(name == "abs" || name == "floor" || name == "sqrt"){
+                        emit(name == "abs" ? NumericKernel::Abs : name == "floor" ? NumericKernel::Floor : NumericKernel::Sqrt);
+                    }
+                    result = Result::Number;
+                }
+            }else if(callee->type == ValueType::FunctionValue){
+                function = static_cast<FunctionValue*>(callee.get());
+                vector<Statement*> body;
+                for(auto& statement : function->declaration->body){
+                    body.push_back(statement.get());
+                }
+                result = compileStatements(body);
+            }
+            if(result == Result::Failed || kernel.program.size() > maxInstructions){
+                return false;
+            }
+            kernel.returnsBool = result == Result::Bool;
+            compiled = move(kernel);
+            return true;
+        }
+};
+
+inline vector<double> mapArray(const vector<double>& numbers, const NumericKernel& kernel){
+    vector<double> mapped(numbers.size());
+    forEachArrayBlock(numbers.size(), [&](size_t, size_t begin, size_t end){
+        kernel.run(numbers.data() + begin, mapped.data() + begin, end - begin);
+    });
+    return mapped;
+}
+
+inline vector<double> filterArray(const vector<double>& numbers, const NumericKernel& kernel){ //keeps the numbers the kernel gives true for, in their order
+    vector<vector<double>> kept(arrayBlockCount(numbers.size()));
+    forEachArrayBlock(numbers.size(), [&](size_t block, size_t begin, size_t end){
+        vector<double> keep(end - begin);
+        kernel.run(numbers.data() + begin, keep.data(), end - begin);
+        for(size_t i = begin; i < end; i++){
+            if(keep[i - begin] != 0){
+                kept[block].push_back(numbers[i]);
+            }
+        }
+    });
+    size_t total = 0;
+    for(auto& block : kept){
+        total += block.size();
+    }
+    vector<double> filtered;
+    filtered.reserve(total);
+    for(auto& block : kept){
+        filtered.insert(filtered.end(), block.begin(), block.end());
+    }
+    return filtered;
+}
+
+
+#endif
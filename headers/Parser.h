@@ -3,35 +3,78 @@
 
 #include "Lexer.h"
 #include "AstNodes.h"
+#include "Values.h"
 #include <memory>
 #include <vector>
+#include <charconv>
+#include <deque>
+#include <unordered_set>
+#include "ThreadPool.h"
+
+struct LocalVariable{
+    int slot = 0;
+    bool isConstant = false;
+};
+
+struct BlockScope{
+    unordered_map<string, LocalVariable> variables;
+    unordered_set<string> predeclared; //functions of the block that are not parsed yet
+    vector<FunctionDeclarationNode*> functions;
+    int firstSlot = 0;
+};
+
+struct SourceChunk{
+    size_t begin = 0;
+    size_t end = 0;
+    int firstLine = 1;
+};
+
+struct FunctionScope{
+    FunctionDeclarationNode* function = nullptr;
+    vector<BlockScope> blocks;
+    unordered_map<string, int> captureIndices;
+    int nextSlot = 0;
+};
 
 class Parser{
     private:
-        vector<Token> tokens;
+        deque<Token> tokens; //lookahead, pulled from the lexer on demand
         Lexer lexer;
         Program program;
+        vector<FunctionScope> functionScopes;
+
+        static const size_t parallelThreshold = 1 << 20; //smaller sources are lexed and parsed on one thread
 
         bool notTheEnd(){
-            return !tokens.empty() && tokens[0].art != TokenArt::EndOfFile;
+            return thisToken().art != TokenArt::EndOfFile;
         }
 
-        Token thisToken(){
-            return tokens[0];
+        const Token& thisToken(){
+            if(tokens.empty()){
+                tokens.push_back(lexer.nextToken());
+            }
+            return tokens.front();
         }
 
         Token thisEat(){
-            Token prevToken = tokens[0];
-            tokens.erase(tokens.begin());
+            thisToken();
+            Token prevToken = move(tokens.front());
+            tokens.pop_front();
             return prevToken;
         }
 
+        const Token& peekToken(size_t ahead){
+            while(tokens.size() <= ahead){
+                tokens.push_back(lexer.nextToken());
+            }
+            return tokens[ahead];
+        }
+
         Token expect(TokenArt tokentype, string tokentypeName){
             if (thisToken().art == tokentype){
                 return thisEat();
             }else{
-                cerr<<"\n[[Stage]]: Parsing     [[ERROR]] : Expected "<<tokentypeName<<" got "<<thisToken().value;
-                exit(1);
+                throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] : Expected " + tokentypeName + " got " + thisToken().value, thisToken().line);
             }
         }
 
@@ -48,8 +91,19 @@ class Parser{
                     return parseIf();
                 case TokenArt::For:
                     return parseFor();
-                default:
-                    return parseExpressions();
+                case TokenArt::Parallel:
+                    return parseParallelFor();
+                case TokenArt::Function:
+                    return parseFunctionDeclaration();
+                case TokenArt::Return:
+                    return parseReturn();
+                default:{
+                    shared_ptr<Expression> expression = parseExpressions();
+                    if(expression->node != NodeType::VariableAssignmentNode){
+                        expect(TokenArt::Semicolon, ";");
+                    }
+                    return expression;
+                }
             }
         }
 
@@ -60,9 +114,12 @@ class Parser{
         shared_ptr<Expression> parsePrimitives(){
             switch (thisToken().art){
                 case TokenArt::Number:
-                    return make_shared<NumberNode>(stod(thisEat().value)); 
-                case TokenArt::Identifier:
-                    return make_shared<IdentifierNode>(thisEat().value);
+                    return parseNumber(thisEat().value); 
+                case TokenArt::Identifier:{
+                    shared_ptr<IdentifierNode> identifier = make_shared<IdentifierNode>(thisEat().value);
+                    resolveIdentifier(identifier);
+                    return identifier;
+                }
                 case TokenArt::OpenParen:{
                     thisEat();
                     shared_ptr<Expression> value = parseExpressions();
@@ -70,12 +127,127 @@ class Parser{
                     return value;
                 }
                 case TokenArt::String:{
-                    return make_shared<StringNode>(thisEat().value);
+                    shared_ptr<StringNode> literal = make_shared<StringNode>(thisEat().value);
+                    literal->interned = internString(literal->value);
+                    return literal;
                 }
+                case TokenArt::OpenBrace:
+                    return parseObjectLiteral();
+                case TokenArt::OpenDictionary:
+                    return parseDictionaryLiteral();
+                case TokenArt::OpenBracket:
+                    return parseArrayLiteral();
                 default:
-                    cerr<<"\n[[Stage]]: Parsing     [[ERROR]] Unknown token : "<<thisToken().value;
-                    exit(1);
+                    throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] Unknown token : " + thisToken().value, thisToken().line);
+            }
+        }
+
+        shared_ptr<Expression> parseNumber(const string& literal){
+            const char* end = literal.data() + literal.size();
+            if(literal.find_first_of(".eE") == string::npos){
+                int64_t integer = 0;
+                from_chars_result parsed = from_chars(literal.data(), end, integer);
+                if(parsed.ec == errc() && parsed.ptr == end){
+                    return make_shared<NumberNode>(integer);
+                }
+            }
+            double number = 0;
+            from_chars_result parsed = from_chars(literal.data(), end, number);
+            if(parsed.ec != errc() || parsed.ptr != end){
+                throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] : Invalid number literal " + literal, thisToken().line);
+            }
+            return make_shared<NumberNode>(number);
+        }
+
+        shared_ptr<Expression> parseObjectLiteral(){
+            expect(TokenArt::OpenBrace, "{");
+            vector<pair<string, shared_ptr<Expression>>> properties;
+            while(notTheEnd() && thisToken().art != TokenArt::CloseBrace){
+                string propertyName = expect(TokenArt::Identifier, "Property name").value;
+                for(auto &property : properties){
+                    if(property.first == propertyName){
+                        throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] : Duplicate property " + propertyName + " in object literal", thisToken().line);
+                    }
+                }
+                expect(TokenArt::Colon, ":");
+                properties.push_back({propertyName, parseExpressions()});
+                if(thisToken().art != TokenArt::Comma){
+                    break;
+                }
+                thisEat();
+            }
+            expect(TokenArt::CloseBrace, "}");
+            return make_shared<ObjectLiteralNode>(properties);
+        }
+
+        shared_ptr<Expression> parseDictionaryLiteral(){ //keys are names, strings or numbers
+            expect(TokenArt::OpenDictionary, "#{");
+            vector<pair<string, shared_ptr<Expression>>> entries;
+            vector<size_t> hashes;
+            while(notTheEnd() && thisToken().art != TokenArt::CloseBrace){
+                string key;
+                if(thisToken().art == TokenArt::Number){
+                    shared_ptr<Expression> number = parseNumber(thisEat().value);
+                    NumberValue value(static_cast<NumberNode*>(number.get())->value);
+                    value.integer = static_cast<NumberNode*>(number.get())->integer;
+                    value.isInteger = static_cast<NumberNode*>(number.get())->isInteger;
+                    key = formatNumber(value);
+                }else if(thisToken().art == TokenArt::String || thisToken().art == TokenArt::Identifier){
+                    key = thisEat().value;
+                }else{
+                    throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] : Expected dictionary key got " + thisToken().value, thisToken().line);
+                }
+                for(auto &entry : entries){
+                    if(entry.first == key){
+                        throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] : Duplicate key " + key + " in dictionary literal", thisToken().line);
+                    }
+                }
+                expect(TokenArt::Colon, ":");
+                entries.push_back({key, parseExpressions()});
+                hashes.push_back(hashKey(key));
+                if(thisToken().art != TokenArt::Comma){
+                    break;
+                }
+                thisEat();
             }
+            expect(TokenArt::CloseBrace, "}");
+            return make_shared<DictionaryLiteralNode>(entries, hashes);
+        }
+
+        shared_ptr<Expression> parseArrayLiteral(){
+            expect(TokenArt::OpenBracket, "[");
+            vector<shared_ptr<Expression>> elements;
+            while(notTheEnd() && thisToken().art != TokenArt::CloseBracket){
+                elements.push_back(parseExpressions());
+                if(thisToken().art != TokenArt::Comma){
+                    break;
+                }
+                thisEat();
+            }
+            expect(TokenArt::CloseBracket, "]");
+            return make_shared<ArrayLiteralNode>(elements);
+        }
+
+        shared_ptr<Expression> parseCallMemberAccess(){
+            shared_ptr<Expression> object = parsePrimitives();
+            while(notTheEnd() && (thisToken().art == TokenArt::Dot || thisToken().art == TokenArt::OpenParen)){
+                if(thisEat().art == TokenArt::Dot){
+                    string propertyName = expect(TokenArt::Identifier, "Property name").value;
+                    object = make_shared<MemberNode>(object, propertyName);
+                    continue;
+                }
+                vector<shared_ptr<Expression>> arguments;
+                while(notTheEnd() && thisToken().art != TokenArt::CloseParen){
+                    arguments.push_back(parseExpressions());
+                    if(thisToken().art != TokenArt::Comma){
+                        break;
+                    }
+                    thisEat();
+                }
+                expect(TokenArt::CloseParen, ")");
+                object = make_shared<CallNode>(object, arguments);
+            }
+            return object;
         }
 
         shared_ptr<Expression> parseAdditivBinary(){
@@ -89,10 +261,10 @@ class Parser{
         }
 
         shared_ptr<Expression> parseMultiplicativeBinary(){
-            shared_ptr<Expression> left = parsePrimitives();
+            shared_ptr<Expression> left = parseCallMemberAccess();
             while(notTheEnd() && (thisToken().value=="*" || thisToken().value=="/" || thisToken().value=="%")){
                 string operatorValue = thisEat().value;
-                shared_ptr<Expression> right = parsePrimitives();
+                shared_ptr<Expression> right = parseCallMemberAccess();
                 left=make_shared<BinaryNode>(left,right,operatorValue);
             } 
             return left;
@@ -104,22 +276,26 @@ class Parser{
             if(thisToken().art == TokenArt::Semicolon){
                 if(thisToken().art == TokenArt::Semicolon && isConst){
                     thisEat();
-                    cerr<<"\n[[Stage]]: Parsing     [[ERROR]] : Constant variables must be assigned a value!";
-                    exit(1);
+                    throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] : Constant variables must be assigned a value!", thisToken().line);
                 }
                 thisEat();
-                return make_shared<VariableDeclarationNode>(variableName, nullptr, isConst);
+                shared_ptr<VariableDeclarationNode> declaration = make_shared<VariableDeclarationNode>(variableName, nullptr, isConst);
+                declaration->slot = declareLocal(variableName, isConst);
+                return declaration;
             }
             expect(TokenArt::Equal, "=");
             shared_ptr<Expression> value = parseExpressions();
             expect(TokenArt::Semicolon, ";");
-            return make_shared<VariableDeclarationNode>(variableName, value, isConst);
+            shared_ptr<VariableDeclarationNode> declaration = make_shared<VariableDeclarationNode>(variableName, value, isConst);
+            declaration->slot = declareLocal(variableName, isConst);
+            return declaration;
         }
 
         shared_ptr<Expression> parseVariableAssignment(){
             shared_ptr<Expression> left = parseAdditivBinary();
             if(notTheEnd() && thisToken().art== TokenArt::Equal){
                 thisEat();
+                checkAssignable(left);
                 shared_ptr<Expression> assignValue = parseAdditivBinary();
                 expect(TokenArt::Semicolon, ";");
                 return make_shared<VariableAssignmentNode>(left, assignValue);
@@ -137,14 +313,13 @@ class Parser{
         }
 
         shared_ptr<Expression> parseConditional(){
-            shared_ptr<Expression> left = parseMultiplicativeBinary();
+            shared_ptr<Expression> left = parseAdditivBinary();
             if(notTheEnd() && thisToken().value == "<" || thisToken().value == ">" || thisToken().value == "="){
                 string conditionOperator = thisEat().value;
-                shared_ptr<Expression> right = parseMultiplicativeBinary();
+                shared_ptr<Expression> right = parseAdditivBinary();
                 return make_shared<ConditionalNode>(left, right, conditionOperator);
             }else{
-                cerr<<"\n[[Stage]]: Parsing     [[ERROR]] : Expected conditional operator got "<<thisToken().value;
-                exit(1);
+                throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] : Expected conditional operator got " + thisToken().value, thisToken().line);
             }
         }
 
@@ -153,53 +328,347 @@ class Parser{
             expect(TokenArt::OpenParen, "(");
             shared_ptr<Expression> condition = parseConditional();
             expect(TokenArt::CloseParen, ")");
-            expect(TokenArt::OpenBrace, "{");
-            vector<shared_ptr<Statement>> ifBody;
-            while(notTheEnd() && thisToken().art != TokenArt::CloseBrace){
-                ifBody.push_back(parseStatements());
-            }
-            expect(TokenArt::CloseBrace, "}");
+            vector<shared_ptr<Statement>> ifBody = parseBlock();
+            shared_ptr<IfNode> ifNode = make_shared<IfNode>(condition, ifBody);
             if(notTheEnd() && thisToken().art == TokenArt::Else){
                 thisEat();
-                expect(TokenArt::OpenBrace, "{");
-                vector<shared_ptr<Statement>> elseBody;
-                while(notTheEnd() && thisToken().art!= TokenArt::CloseBrace){
-                    elseBody.push_back(parseStatements());
-                }
-                expect(TokenArt::CloseBrace, "}");
-                return make_shared<IfNode>(condition, ifBody, elseBody);
+                ifNode->elseBody = parseBlock();
+            }
+            ifNode->usesFrame = !functionScopes.empty();
+            return ifNode;
+        }
+
+        vector<shared_ptr<Statement>> parseBlock(){
+            expect(TokenArt::OpenBrace, "{");
+            pushBlock();
+            predeclareFunctions();
+            vector<shared_ptr<Statement>> body;
+            while(notTheEnd() && thisToken().art!= TokenArt::CloseBrace){
+                body.push_back(parseStatements());
             }
-            return make_shared<IfNode>(condition, ifBody);
+            expect(TokenArt::CloseBrace, "}");
+            popBlock();
+            return body;
         }
 
         shared_ptr<Statement> parseFor(){
             thisEat();
             expect(TokenArt::OpenParen, "(");
+            pushBlock();
             shared_ptr<Statement> initializer = parseVariableDeclaration(false);
             shared_ptr<Expression> condition = parseConditional();
             expect(TokenArt::Semicolon, ";");
             shared_ptr<Statement> increment = parseVariableAssignment();
             expect(TokenArt::CloseParen, ")");
-            expect(TokenArt::OpenBrace, "{");
-            vector<shared_ptr<Statement>> forBody;
-            while(notTheEnd() && thisToken().art!= TokenArt::CloseBrace){
-                forBody.push_back(parseStatements());
+            vector<shared_ptr<Statement>> forBody = parseBlock();
+            popBlock();
+            shared_ptr<ForNode> forNode = make_shared<ForNode>(initializer, condition, increment, forBody);
+            forNode->usesFrame = !functionScopes.empty();
+            for(auto& statement : forBody){
+                if(statement->node == NodeType::VariableDeclarationNode || statement->node == NodeType::FunctionDeclarationNode){
+                    forNode->bodyDeclares = true;
+                }
+            }
+            return forNode;
+        }
+
+        shared_ptr<Statement> parseParallelFor(){
+            thisEat();
+            if(thisToken().art != TokenArt::For){
+                throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] : Expected for after parallel got " + thisToken().value, thisToken().line);
+            }
+            shared_ptr<Statement> forNode = parseFor();
+            static_cast<ForNode*>(forNode.get())->parallel = true;
+            return forNode;
+        }
+
+        shared_ptr<Statement> parseFunctionDeclaration(){
+            thisEat();
+            string functionName = expect(TokenArt::Identifier, "Function name").value;
+            int slot = functionScopes.empty() || functionScopes.back().blocks.back().predeclared.erase(functionName) == 0 ? declareLocal(functionName, false) : findLocal(functionScopes.back(), functionName)->slot;
+            expect(TokenArt::OpenParen, "(");
+            vector<string> parameters;
+            while(notTheEnd() && thisToken().art != TokenArt::CloseParen){
+                parameters.push_back(expect(TokenArt::Identifier, "Parameter name").value);
+                if(thisToken().art != TokenArt::Comma){
+                    break;
+                }
+                thisEat();
+            }
+            expect(TokenArt::CloseParen, ")");
+            shared_ptr<FunctionDeclarationNode> function = make_shared<FunctionDeclarationNode>(functionName, parameters, slot);
+            functionScopes.push_back(FunctionScope());
+            functionScopes.back().function = function.get();
+            pushBlock();
+            for(auto& parameter : parameters){
+                declareLocal(parameter, false);
+            }
+            function->body = parseBlock();
+            popBlock();
+            functionScopes.pop_back();
+            if(!functionScopes.empty()){
+                BlockScope& block = functionScopes.back().blocks.back();
+                for(FunctionDeclarationNode* earlier : block.functions){
+                    for(size_t i = 0; i < earlier->captures.size(); i++){
+                        if(earlier->captures[i].fromSlot && earlier->captures[i].index == slot){
+                            function->lateCaptures.push_back({earlier, earlier->slot, int(i)});
+                        }
+                    }
+                }
+                block.functions.push_back(function.get());
+            }
+            return function;
+        }
+
+        shared_ptr<Statement> parseReturn(){
+            thisEat();
+            if(functionScopes.empty()){
+                throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] : Return outside of a function", thisToken().line);
+            }
+            shared_ptr<Expression> value = nullptr;
+            if(thisToken().art != TokenArt::Semicolon){
+                value = parseExpressions();
+            }
+            if(value == nullptr || value->node != NodeType::VariableAssignmentNode){
+                expect(TokenArt::Semicolon, ";");
+            }
+            return make_shared<ReturnNode>(value, value != nullptr && value->node == NodeType::CallNode);
+        }
+
+        void pushBlock(){
+            if(functionScopes.empty()){
+                return;
+            }
+            BlockScope block;
+            block.firstSlot = functionScopes.back().nextSlot;
+            functionScopes.back().blocks.push_back(block);
+        }
+
+        void popBlock(){
+            if(functionScopes.empty()){
+                return;
+            }
+            functionScopes.back().nextSlot = functionScopes.back().blocks.back().firstSlot;
+            functionScopes.back().blocks.pop_back();
+        }
+
+        void predeclareFunctions(){ //functions of a block get their slots first, so the ones declared before can call them
+            if(functionScopes.empty()){
+                return;
+            }
+            size_t depth = 0;
+            for(size_t ahead = 0; peekToken(ahead).art != TokenArt::EndOfFile; ahead++){
+                TokenArt art = peekToken(ahead).art;
+                if(art == TokenArt::OpenBrace || art == TokenArt::OpenDictionary){
+                    depth++;
+                }else if(art == TokenArt::CloseBrace){
+                    if(depth == 0){
+                        return;
+                    }
+                    depth--;
+                }else if(art == TokenArt::Function && depth == 0 && peekToken(ahead + 1).art == TokenArt::Identifier){
+                    string name = peekToken(ahead + 1).value;
+                    declareLocal(name, false);
+                    functionScopes.back().blocks.back().predeclared.insert(name);
+                }
+            }
+        }
+
+        int declareLocal(const string& name, bool isConst){ //-1 outside of functions, those variables live in environments
+            if(functionScopes.empty()){
+                return -1;
+            }
+            FunctionScope& scope = functionScopes.back();
+            BlockScope& block = scope.blocks.back();
+            if(block.variables.find(name) != block.variables.end()){
+                throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] : Variable with name '" + name + "' already declared.", thisToken().line);
+            }
+            int slot = scope.nextSlot++;
+            scope.function->frameSize = max(scope.function->frameSize, scope.nextSlot);
+            block.variables[name] = {slot, isConst};
+            return slot;
+        }
+
+        LocalVariable* findLocal(FunctionScope& scope, const string& name){
+            for(auto block = scope.blocks.rbegin(); block != scope.blocks.rend(); block++){
+                auto variable = block->variables.find(name);
+                if(variable != block->variables.end()){
+                    return &variable->second;
+                }
+            }
+            return nullptr;
+        }
+
+        int resolveCapture(size_t level, const string& name){ //captures are copied into the function value when it is created
+            if(level == 0){
+                return -1;
+            }
+            FunctionScope& scope = functionScopes[level];
+            auto known = scope.captureIndices.find(name);
+            if(known != scope.captureIndices.end()){
+                return known->second;
+            }
+            CaptureSource source;
+            LocalVariable* local = findLocal(functionScopes[level-1], name);
+            if(local != nullptr){
+                source = {true, local->slot};
+            }else{
+                int outerCapture = resolveCapture(level-1, name);
+                if(outerCapture < 0){
+                    return -1;
+                }
+                source = {false, outerCapture};
+            }
+            scope.function->captures.push_back(source);
+            scope.captureIndices[name] = scope.function->captures.size()-1;
+            return scope.captureIndices[name];
+        }
+
+        void resolveIdentifier(shared_ptr<IdentifierNode> identifier){
+            if(functionScopes.empty()){
+                return;
+            }
+            LocalVariable* local = findLocal(functionScopes.back(), identifier->value);
+            if(local != nullptr){
+                identifier->slot = local->slot;
+                return;
+            }
+            identifier->capture = resolveCapture(functionScopes.size()-1, identifier->value);
+        }
+
+        void checkAssignable(shared_ptr<Expression> target){
+            if(target->node != NodeType::IdentifierNode || functionScopes.empty()){
+                return;
+            }
+            shared_ptr<IdentifierNode> identifier = dynamic_pointer_cast<IdentifierNode>(target);
+            if(identifier->capture >= 0){
+                throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] : Captured variable '" + identifier->value + "' cannot be assigned inside a nested function", thisToken().line);
+            }
+            LocalVariable* local = findLocal(functionScopes.back(), identifier->value);
+            if(local != nullptr && local->isConstant){
+                throw SyntaxError("\n[[Stage]]: Parsing     [[ERROR]] : Variable with name '" + identifier->value + "' is constant and cannot be assigned.", thisToken().line);
             }
-            expect(TokenArt::CloseBrace, "}");
-            return make_shared<ForNode>(initializer, condition, increment, forBody);
         }
         
 
+        static bool startsStatement(const string& source, size_t position){ //an identifier or keyword other than else follows
+            while(position < source.size() && isspace(source[position])){
+                position++;
+            }
+            if(position >= source.size() || !isalpha(source[position])){
+                return false;
+            }
+            return source.compare(position, 4, "else") != 0 || (position + 4 < source.size() && isalpha(source[position + 4]));
+        }
+
+        static vector<SourceChunk> splitStatements(const string& source, size_t chunkCount){ //cuts only after a top-level ; or } outside of strings
+            vector<SourceChunk> chunks;
+            size_t target = source.size() / chunkCount;
+            size_t begin = 0;
+            int line = 1;
+            int firstLine = 1;
+            int depth = 0;
+            bool inString = false;
+            for(size_t i = 0; i < source.size(); i++){
+                char c = source[i];
+                if(c == '\n'){
+                    line++;
+                }
+                if(inString){
+                    inString = c != '"';
+                    continue;
+                }
+                if(c == '"'){
+                    inString = true;
+                }else if(c == '{' || c == '('){
+                    depth++;
+                }else if(c == '}' || c == ')'){
+                    depth--;
+                }
+                if(depth != 0 || i + 1 - begin < target || chunks.size() + 1 == chunkCount){
+                    continue;
+                }
+                if(c == ';' || (c == '}' && startsStatement(source, i + 1))){
+                    chunks.push_back({begin, i + 1, firstLine});
+                    begin = i + 1;
+                    firstLine = line;
+                }
+            }
+            chunks.push_back({begin, source.size(), firstLine});
+            return chunks;
+        }
+
+        Program produceASTParallel(const string& source){ //top-level statements do not share parser state, so chunks parse independently
+            vector<SourceChunk> chunks = splitStatements(source, threadPool().size() * 4);
+            vector<Parser> parsers(chunks.size());
+            vector<vector<Token>> chunkTokens(chunks.size());
+            vector<future<void>> parsed;
+            AtomTable* atoms = activeAtomTable();
+            for(size_t i = 0; i < chunks.size(); i++){
+                parsed.push_back(threadPool().submit([&, i]{
+                    AtomTable* previousAtoms = activeAtomTable();
+                    activeAtomTable() = atoms;
+                    Parser& parser = parsers[i];
+                    try{
+                        parser.lexer.setSource(source.substr(chunks[i].begin, chunks[i].end - chunks[i].begin), chunks[i].firstLine);
+                        chunkTokens[i] = parser.lexer.tokenize();
+                        parser.tokens.assign(chunkTokens[i].begin(), chunkTokens[i].end());
+                        while(parser.notTheEnd()){
+                            parser.program.statements.push_back(parser.parseStatements());
+                        }
+                    }catch(...){
+                        activeAtomTable() = previousAtoms;
+                        throw;
+                    }
+                    activeAtomTable() = previousAtoms;
+                }));
+            }
+            for(auto& chunk : parsed){
+                chunk.wait();
+            }
+            for(size_t i = 0; i < chunks.size(); i++){ //the first error in source order is reported
+                parsed[i].get();
+            }
+            Token endOfFile = chunkTokens.back().back();
+            vector<Token> allTokens;
+            for(size_t i = 0; i < chunks.size(); i++){
+                allTokens.insert(allTokens.end(), make_move_iterator(chunkTokens[i].begin()), make_move_iterator(chunkTokens[i].end() - 1));
+                vector<Token>().swap(chunkTokens[i]);
+                for(auto& statement : parsers[i].program.statements){
+                    program.statements.push_back(move(statement));
+                }
+            }
+            allTokens.push_back(endOfFile);
+            Lexer::print(allTokens);
+            return program;
+        }
+
     public:
         Program produceAST(string source){
+            if(source.size() >= parallelThreshold && threadPool().size() > 1){
+                return produceASTParallel(source);
+            }
             lexer.setSource(source);
-            tokens = lexer.tokenize();
+            vector<Token> allTokens = lexer.tokenize();
             lexer.print();
+            tokens.assign(allTokens.begin(), allTokens.end());
             while (notTheEnd()){
                 program.statements.push_back(parseStatements());
             }
             return program;
         }
+
+        void setInput(istream& input){
+            lexer.setInput(input);
+            tokens.clear();
+        }
+
+        shared_ptr<Statement> nextStatement(){ //parses the next top-level statement of the input, nullptr at its end
+            if(!notTheEnd()){
+                return nullptr;
+            }
+            return parseStatements();
+        }
 };
 
 #endif
\ No newline at end of file
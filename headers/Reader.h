@@ -11,13 +11,22 @@ class Reader{
     private:
     public:
         string readFile(string filepath){
+            if(filepath == "-"){
+                return readStream(cin);
+            }
             ifstream file(filepath);
+            string content = readStream(file);
+            file.close();
+            return content;
+        }
+
+        string readStream(istream& input){
             string content = "";
             string line = "";
-            while(getline(file,line)){
+            while(getline(input,line)){
                 content += line;
+                content += '\n';
             }
-            file.close();
             return content;
         }
 };
@@ -0,0 +1,353 @@
+#ifndef SNAPSHOT_H_v1
+#define SNAPSHOT_H_v1
+
+#include "iostream"
+#include "fstream"
+#include "sstream"
+#include "string"
+#include "vector"
+#include "cstring"
+#include "unordered_map"
+#include "Values.h"
+#include "Environment.h"
+
+using namespace std;
+
+struct SnapshotError : ScriptError{
+    SnapshotError(const string& message):ScriptError("\n[[Stage]] : Snapshot  [[ERROR]] : " + message + "\n"){}
+};
+
+/*
+    Binary image of the variables of a global environment and of every value reachable from them.
+    Layout: magic and version, the value table, then the variables as (name, constant, value index).
+    Values refer to each other by their index in the table, so shared objects stay shared and cycles survive.
+    Native functions are stored by name and resolved in the environment the snapshot is loaded into.
+    User functions point into a syntax tree and cannot be stored.
+*/
+class Snapshot{
+    private:
+        enum Tag : uint8_t{ Null, False, True, Integer, Double, String, Object, Native, Dictionary, Array };
+
+        static constexpr char magic[8] = {'C','A','E','L','S','N','A','P'};
+        static constexpr uint32_t version = 1;
+
+        struct Record{
+            Tag tag;
+            int64_t integer = 0;
+            double number = 0;
+            string text; //string content or native name
+            vector<pair<string, uint32_t>> properties;
+            vector<double> numbers;
+        };
+
+        //writing
+        string image;
+        vector<R_Value*> order;
+        unordered_map<R_Value*, uint32_t> indices;
+
+        //reading
+        const string* input = nullptr;
+        size_t position = 0;
+
+        void writeInteger(uint64_t value, int bytes){
+            for(int i = 0; i < bytes; i++){
+                image += char((value >> (8 * i)) & 0xff);
+            }
+        }
+
+        void writeText(const string& text){
+            writeInteger(text.size(), 4);
+            image += text;
+        }
+
+        void writeDouble(double number){
+            uint64_t bits;
+            memcpy(&bits, &number, sizeof(bits));
+            writeInteger(bits, 8);
+        }
+
+        uint64_t readInteger(int bytes){
+            if(input->size() - position < size_t(bytes)){
+                throw SnapshotError("Snapshot is truncated");
+            }
+            uint64_t value = 0;
+            for(int i = 0; i < bytes; i++){
+                value |= uint64_t(uint8_t((*input)[position++])) << (8 * i);
+            }
+            return value;
+        }
+
+        double readDouble(){
+            uint64_t bits = readInteger(8);
+            double number;
+            memcpy(&number, &bits, sizeof(number));
+            return number;
+        }
+
+        string readText(){
+            size_t length = readInteger(4);
+            if(input->size() - position < length){
+                throw SnapshotError("Snapshot is truncated");
+            }
+            string text = input->substr(position, length);
+            position += length;
+            return text;
+        }
+
+        uint32_t collect(R_Value* root, const string& variable){ //gives every reachable value its index, objects before their properties
+            vector<R_Value*> pending{root}; //a worklist instead of recursion, so long chains of objects do not use up the stack
+            while(!pending.empty()){
+                R_Value* value = pending.back();
+                pending.pop_back();
+                if(indices.count(value) != 0){
+                    continue;
+                }
+                if(value->type == ValueType::FunctionValue){
+                    throw SnapshotError("Variable '" + variable + "' refers to the function '" + static_cast<FunctionValue*>(value)->name + "', user functions cannot be stored in a snapshot");
+                }
+                if(value->type == ValueType::FileValue){
+                    throw SnapshotError("Variable '" + variable + "' refers to an open file, files cannot be stored in a snapshot");
+                }
+                indices.emplace(value, uint32_t(order.size()));
+                order.push_back(value);
+                if(value->type == ValueType::ObjectValue){ //pushed in reverse, so properties get their indices in the order they are listed
+                    auto& slots = static_cast<ObjectValue*>(value)->slots;
+                    for(size_t i = slots.size(); i-- > 0;){
+                        pending.push_back(slots[i].get());
+                    }
+                }else if(value->type == ValueType::DictionaryValue){
+                    const auto& entries = static_cast<DictionaryValue*>(value)->entries.all();
+                    for(size_t i = entries.size(); i-- > 0;){
+                        pending.push_back(entries[i].value.get());
+                    }
+                }
+            }
+            return indices[root];
+        }
+
+        void writeValue(R_Value* value){
+            switch(value->type){
+                case ValueType::NullValue:
+                    writeInteger(Null, 1);
+                    break;
+                case ValueType::BoolValue:
+                    writeInteger(static_cast<BoolValue*>(value)->value ? True : False, 1);
+                    break;
+                case ValueType::NumberValue:{
+                    NumberValue* number = static_cast<NumberValue*>(value);
+                    if(number->isInteger){
+                        writeInteger(Integer, 1);
+                        writeInteger(uint64_t(number->integer), 8);
+                    }else{
+                        writeInteger(Double, 1);
+                        writeDouble(number->value);
+                    }
+                    break;
+                }
+                case ValueType::StringValue:
+                    writeInteger(String, 1);
+                    writeText(string(static_cast<StringValue*>(value)->text()));
+                    break;
+                case ValueType::ObjectValue:{
+                    ObjectValue* object = static_cast<ObjectValue*>(value);
+                    writeInteger(Object, 1);
+                    writeInteger(object->slots.size(), 4);
+                    for(size_t i = 0; i < object->slots.size(); i++){
+                        writeText(object->shape->propertyNames[i]);
+                        writeInteger(indices[object->slots[i].get()], 4);
+                    }
+                    break;
+                }
+                case ValueType::DictionaryValue:{
+                    const auto& entries = static_cast<DictionaryValue*>(value)->entries.all();
+                    writeInteger(Dictionary, 1);
+                    writeInteger(entries.size(), 4);
+                    for(auto& entry : entries){
+                        writeText(entry.key);
+                        writeInteger(indices[entry.value.get()], 4);
+                    }
+                    break;
+                }
+                case ValueType::ArrayValue:{
+                    const vector<double>& numbers = static_cast<ArrayValue*>(value)->numbers;
+                    writeInteger(Array, 1);
+                    writeInteger(numbers.size(), 4);
+                    for(double number : numbers){
+                        writeDouble(number);
+                    }
+                    break;
+                }
+                default:
+                    writeInteger(Native, 1);
+                    writeText(static_cast<NativeFunctionValue*>(value)->name);
+                    break;
+            }
+        }
+
+        Record readRecord(uint32_t valueCount){
+            Record record;
+            record.tag = Tag(readInteger(1));
+            switch(record.tag){
+                case Null: case False: case True:
+                    break;
+                case Integer:
+                    record.integer = int64_t(readInteger(8));
+                    break;
+                case Double:
+                    record.number = readDouble();
+                    break;
+                case Array:{
+                    uint32_t count = readInteger(4);
+                    if((input->size() - position) / 8 < count){
+                        throw SnapshotError("Snapshot is truncated");
+                    }
+                    record.numbers.resize(count);
+                    for(uint32_t i = 0; i < count; i++){
+                        record.numbers[i] = readDouble();
+                    }
+                    break;
+                }
+                case String: case Native:
+                    record.text = readText();
+                    break;
+                case Object: case Dictionary:{
+                    uint32_t propertyCount = readInteger(4);
+                    for(uint32_t i = 0; i < propertyCount; i++){
+                        string name = readText();
+                        uint32_t index = readInteger(4);
+                        if(index >= valueCount){
+                            throw SnapshotError("Snapshot refers to a value that does not exist");
+                        }
+                        record.properties.emplace_back(move(name), index);
+                    }
+                    break;
+                }
+                default:
+                    throw SnapshotError("Snapshot contains an unknown value");
+            }
+            return record;
+        }
+
+        static bool isBuiltin(const string& name, const shared_ptr<R_Value>& value, bool isConst){ //declared by every fresh global environment
+            if(name == "null" || name == "true" || name == "false"){
+                return true;
+            }
+            return isConst && value->type == ValueType::NativeFunctionValue && static_cast<NativeFunctionValue*>(value.get())->name == name;
+        }
+
+    public:
+        string write(const Environment& environment){
+            vector<tuple<string, bool, uint32_t>> variables;
+            environment.forEachVariable([&](const string& name, const shared_ptr<R_Value>& value, bool isConst){
+                if(!isBuiltin(name, value, isConst)){
+                    variables.emplace_back(name, isConst, collect(value.get(), name));
+                }
+            });
+
+            image.append(magic, sizeof(magic));
+            writeInteger(version, 4);
+            writeInteger(order.size(), 4);
+            for(R_Value* value : order){
+                writeValue(value);
+            }
+            writeInteger(variables.size(), 4);
+            for(auto& variable : variables){
+                writeText(get<0>(variable));
+                writeInteger(get<1>(variable), 1);
+                writeInteger(get<2>(variable), 4);
+            }
+            return move(image);
+        }
+
+        void read(const string& snapshot, const shared_ptr<Environment>& environment){
+            input = &snapshot;
+            position = 0;
+            if(snapshot.size() < sizeof(magic) || memcmp(snapshot.data(), magic, sizeof(magic)) != 0){
+                throw SnapshotError("File is not a snapshot");
+            }
+            position = sizeof(magic);
+            if(readInteger(4) != version){
+                throw SnapshotError("Snapshot was written by a different version");
+            }
+
+            uint32_t valueCount = readInteger(4);
+            vector<Record> records;
+            vector<shared_ptr<R_Value>> values;
+            records.reserve(valueCount);
+            values.reserve(valueCount);
+            for(uint32_t i = 0; i < valueCount; i++){ //objects are created empty first, so properties can refer to any value
+                records.push_back(readRecord(valueCount));
+                Record& record = records.back();
+                switch(record.tag){
+                    case Null: values.push_back(makeNullValue()); break;
+                    case False: values.push_back(makeBoolValue(false)); break;
+                    case True: values.push_back(makeBoolValue(true)); break;
+                    case Integer: values.push_back(makeIntegerValue(record.integer)); break;
+                    case Double: values.push_back(make_shared<NumberValue>(record.number)); break;
+                    case String: values.push_back(makeStringValue(move(record.text))); break;
+                    case Object: values.push_back(makeObjectValue()); break;
+                    case Dictionary: values.push_back(makeDictionaryValue()); break;
+                    case Array: values.push_back(makeArrayValue(move(record.numbers))); break;
+                    default:{
+                        shared_ptr<R_Value> native = environment->findVariable(record.text);
+                        if(native == nullptr || native->type != ValueType::NativeFunctionValue){
+                            throw SnapshotError("Snapshot refers to the native function '" + record.text + "' which is not registered");
+                        }
+                        values.push_back(native);
+                    }
+                }
+            }
+            for(uint32_t i = 0; i < valueCount; i++){
+                if(records[i].tag == Object){
+                    ObjectValue* object = static_cast<ObjectValue*>(values[i].get());
+                    for(auto& property : records[i].properties){ //same property order, so the objects get the same shapes again
+                        object->setProperty(property.first, values[property.second]);
+                    }
+                }else if(records[i].tag == Dictionary){
+                    DictionaryValue* dictionary = static_cast<DictionaryValue*>(values[i].get());
+                    for(auto& entry : records[i].properties){ //same insertion order, so positions for keyAt stay the same
+                        dictionary->set(entry.first, hashKey(entry.first), values[entry.second]);
+                    }
+                }
+            }
+
+            uint32_t variableCount = readInteger(4);
+            for(uint32_t i = 0; i < variableCount; i++){
+                string name = readText();
+                bool isConst = readInteger(1) != 0;
+                uint32_t index = readInteger(4);
+                if(index >= valueCount){
+                    throw SnapshotError("Snapshot refers to a value that does not exist");
+                }
+                if(environment->findVariable(name) != nullptr){
+                    throw SnapshotError("Snapshot declares '" + name + "' which is already declared");
+                }
+                environment->declareVariable(name, values[index], isConst);
+            }
+            if(position != snapshot.size()){
+                throw SnapshotError("Snapshot has trailing data");
+            }
+        }
+};
+
+inline void writeSnapshot(const string& filename, const Environment& environment){
+    string image = Snapshot().write(environment);
+    ofstream file(filename, ios::binary | ios::trunc);
+    file.write(image.data(), image.size());
+    if(!file){
+        throw SnapshotError("Could not write the snapshot to '" + filename + "'");
+    }
+}
+
+inline void loadSnapshot(const string& filename, const shared_ptr<Environment>& environment){
+    ifstream file(filename, ios::binary);
+    if(!file){
+        throw SnapshotError("Could not open the snapshot '" + filename + "'");
+    }
+    ostringstream content;
+    content << file.rdbuf();
+    Snapshot().read(content.str(), environment);
+}
+
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef STRING_SEARCH_H_v1
+#define STRING_SEARCH_H_v1
+
+#include "string"
+#include "cstring"
+#include "algorithm"
+#include <string_view>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CAEL_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/*
+    Search and comparison kernels of the string natives.
+    A needle is searched by comparing its first and its last byte at 16 or 32 positions at once and only
+    comparing the bytes in between where both match, which skips most of the text without a branch.
+    Each kernel has an AVX2, an SSE2 and a scalar version, the best one the processor supports is chosen once.
+*/
+
+constexpr size_t textNotFound = string_view::npos;
+
+inline size_t findTextScalar(string_view text, string_view needle, size_t from){
+    return text.find(needle, from);
+}
+
+inline int compareIgnoreCaseScalar(string_view left, string_view right, size_t from){ //ASCII letters only, other bytes compare as they are
+    size_t common = min(left.size(), right.size());
+    for(size_t i = from; i < common; i++){
+        unsigned char a = left[i], b = right[i];
+        a = a >= 'A' && a <= 'Z' ? a + 32 : a;
+        b = b >= 'A' && b <= 'Z' ? b + 32 : b;
+        if(a != b){
+            return a < b ? -1 : 1;
+        }
+    }
+    return left.size() == right.size() ? 0 : (left.size() < right.size() ? -1 : 1);
+}
+
+#ifdef CAEL_X86_SIMD
+
+__attribute__((target("avx2"))) inline size_t findTextAvx2(string_view text, string_view needle, size_t from){ //needle of two or more bytes
+    size_t last = needle.size() - 1;
+    __m256i first = _mm256_set1_epi8(needle[0]), final = _mm256_set1_epi8(needle[last]);
+    size_t i = from;
+    for(; i + last + 32 <= text.size(); i += 32){
+        __m256i starts = _mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i*)(text.data() + i)));
+        __m256i ends = _mm256_cmpeq_epi8(final, _mm256_loadu_si256((const __m256i*)(text.data() + i + last)));
+        uint32_t candidates = uint32_t(_mm256_movemask_epi8(_mm256_and_si256(starts, ends)));
+        while(candidates != 0){
+            size_t position = i + __builtin_ctz(candidates);
+            if(memcmp(text.data() + position + 1, needle.data() + 1, last - 1) == 0){
+                return position;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+    return findTextScalar(text, needle, i);
+}
+
+__attribute__((target("sse2"))) inline size_t findTextSse2(string_view text, string_view needle, size_t from){
+    size_t last = needle.size() - 1;
+    __m128i first = _mm_set1_epi8(needle[0]), final = _mm_set1_epi8(needle[last]);
+    size_t i = from;
+    for(; i + last + 16 <= text.size(); i += 16){
+        __m128i starts = _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i*)(text.data() + i)));
+        __m128i ends = _mm_cmpeq_epi8(final, _mm_loadu_si128((const __m128i*)(text.data() + i + last)));
+        uint32_t candidates = uint32_t(_mm_movemask_epi8(_mm_and_si128(starts, ends)));
+        while(candidates != 0){
+            size_t position = i + __builtin_ctz(candidates);
+            if(memcmp(text.data() + position + 1, needle.data() + 1, last - 1) == 0){
+                return position;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+    return findTextScalar(text, needle, i);
+}
+
+//A-Z are folded to a-z: adding 128 - 'A' moves the capitals to the 26 smallest signed bytes, so one signed compare finds them
+__attribute__((target("avx2"))) inline int compareIgnoreCaseAvx2(string_view left, string_view right, size_t from){
+    __m256i shift = _mm256_set1_epi8(char(128 - 'A')), limit = _mm256_set1_epi8(char(-128 + 26)), caseBit = _mm256_set1_epi8(0x20);
+    size_t common = min(left.size(), right.size());
+    size_t i = from;
+    for(; i + 32 <= common; i += 32){
+        __m256i a = _mm256_loadu_si256((const __m256i*)(left.data() + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(right.data() + i));
+        a = _mm256_or_si256(a, _mm256_and_si256(_mm256_cmpgt_epi8(limit, _mm256_add_epi8(a, shift)), caseBit));
+        b = _mm256_or_si256(b, _mm256_and_si256(_mm256_cmpgt_epi8(limit, _mm256_add_epi8(b, shift)), caseBit));
+        uint32_t equal = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+        if(equal != 0xffffffffu){
+            return compareIgnoreCaseScalar(left, right, i + __builtin_ctz(~equal));
+        }
+    }
+    return compareIgnoreCaseScalar(left, right, i);
+}
+
+__attribute__((target("sse2"))) inline int compareIgnoreCaseSse2(string_view left, string_view right, size_t from){
+    __m128i shift = _mm_set1_epi8(char(128 - 'A')), limit = _mm_set1_epi8(char(-128 + 26)), caseBit = _mm_set1_epi8(0x20);
+    size_t common = min(left.size(), right.size());
+    size_t i = from;
+    for(; i + 16 <= common; i += 16){
+        __m128i a = _mm_loadu_si128((const __m128i*)(left.data() + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(right.data() + i));
+        a = _mm_or_si128(a, _mm_and_si128(_mm_cmpgt_epi8(limit, _mm_add_epi8(a, shift)), caseBit));
+        b = _mm_or_si128(b, _mm_and_si128(_mm_cmpgt_epi8(limit, _mm_add_epi8(b, shift)), caseBit));
+        uint32_t equal = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+        if(equal != 0xffffu){
+            return compareIgnoreCaseScalar(left, right, i + __builtin_ctz(~equal));
+        }
+    }
+    return compareIgnoreCaseScalar(left, right, i);
+}
+
+#endif
+
+struct StringKernels{
+    const char* name;
+    size_t (*findText)(string_view text, string_view needle, size_t from);
+    int (*compareIgnoreCase)(string_view left, string_view right, size_t from);
+};
+
+inline const StringKernels& stringKernels(){
+    static const StringKernels kernels = []() -> StringKernels{
+#ifdef CAEL_X86_SIMD
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")){
+            return {"avx2", findTextAvx2, compareIgnoreCaseAvx2};
+        }
+        if(__builtin_cpu_supports("sse2")){
+            return {"sse2", findTextSse2, compareIgnoreCaseSse2};
+        }
+#endif
+        return {"scalar", findTextScalar, compareIgnoreCaseScalar};
+    }();
+    return kernels;
+}
+
+inline size_t findText(string_view text, string_view needle, size_t from = 0){ //position of the first occurrence at or after from
+    if(needle.size() <= 1 || from >= text.size()){
+        if(needle.empty()){
+            return from <= text.size() ? from : textNotFound;
+        }
+        if(from >= text.size()){
+            return textNotFound;
+        }
+        const void* found = memchr(text.data() + from, needle[0], text.size() - from); //the C library already searches single bytes with vectors
+        return found == nullptr ? textNotFound : size_t(static_cast<const char*>(found) - text.data());
+    }
+    return stringKernels().findText(text, needle, from);
+}
+
+inline int compareIgnoreCase(string_view left, string_view right){ //-1, 0 or 1, ASCII letters compare without their case
+    return stringKernels().compareIgnoreCase(left, right, 0);
+}
+
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef THREADPOOL_H_v1
+#define THREADPOOL_H_v1
+
+#include "vector"
+#include "deque"
+#include "thread"
+#include "mutex"
+#include "condition_variable"
+#include "functional"
+#include "future"
+#include "memory"
+
+using namespace std;
+
+inline bool& onPoolThread(){ //true on the workers, work they run must not wait for other pool tasks
+    thread_local bool worker = false;
+    return worker;
+}
+
+class ThreadPool{
+    private:
+        vector<thread> workers;
+        deque<function<void()>> tasks;
+        mutex tasksLock;
+        condition_variable tasksAvailable;
+        bool stopping = false;
+
+        void work(){
+            onPoolThread() = true;
+            while(true){
+                function<void()> task;
+                {
+                    unique_lock<mutex> lock(tasksLock);
+                    tasksAvailable.wait(lock, [this]{ return stopping || !tasks.empty(); });
+                    if(stopping && tasks.empty()){
+                        return;
+                    }
+                    task = move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+    public:
+        ThreadPool(size_t threadCount){
+            for(size_t i = 0; i < threadCount; i++){
+                workers.emplace_back([this]{ work(); });
+            }
+        }
+
+        ~ThreadPool(){
+            {
+                lock_guard<mutex> lock(tasksLock);
+                stopping = true;
+            }
+            tasksAvailable.notify_all();
+            for(auto& worker : workers){
+                worker.join();
+            }
+        }
+
+        size_t size() const{
+            return workers.size();
+        }
+
+        template<typename Task>
+        future<void> submit(Task task){ //exceptions thrown by the task are rethrown by future::get
+            shared_ptr<packaged_task<void()>> packaged = make_shared<packaged_task<void()>>(move(task));
+            future<void> result = packaged->get_future();
+            {
+                lock_guard<mutex> lock(tasksLock);
+                tasks.emplace_back([packaged]{ (*packaged)(); });
+            }
+            tasksAvailable.notify_one();
+            return result;
+        }
+};
+
+inline ThreadPool& threadPool(){ //never destroyed, an exit() on a worker thread must not join the pool it runs on
+    static ThreadPool* pool = new ThreadPool(max(1u, thread::hardware_concurrency()));
+    return *pool;
+}
+
+
+#endif
@@ -0,0 +1,422 @@
+#ifndef TYPEINFERENCE_H_v1
+#define TYPEINFERENCE_H_v1
+
+#include "AstNodes.h"
+#include "ExecutionLimits.h"
+#include "string"
+#include "vector"
+#include "set"
+#include "unordered_map"
+
+using namespace std;
+
+struct TypeError : ScriptError{
+    TypeError(const string& message):ScriptError("\n[[Stage]] : Type checking  [[ERROR]] : " + message + "\n"){}
+};
+
+enum class StaticType{
+    Unknown,
+    Null,
+    Bool,
+    Number,
+    String,
+    Object,
+    Function,
+    Dictionary,
+    Array
+};
+
+//Flow sensitive pass over the AST: tracks the type of every variable through each scope, annotates
+//binary and conditional nodes whose operand types are known and reports operations that always fail.
+class TypeInference{
+    private:
+        struct Scope{
+            unordered_map<string, StaticType> variables;
+            bool functionBoundary = false; //variables outside of a function can change between its calls
+            bool operator==(const Scope& other) const{
+                return variables == other.variables && functionBoundary == other.functionBoundary;
+            }
+        };
+
+        vector<Scope> scopes = { Scope() };
+        set<string> tainted; //assigned inside a function, so they can change with every call
+        int silent = 0; //errors are only reported once a loop reached its fixed point
+
+        static const char* typeName(StaticType type){
+            switch(type){
+                case StaticType::Null: return "Null";
+                case StaticType::Bool: return "Boolean";
+                case StaticType::Number: return "Number";
+                case StaticType::String: return "String";
+                case StaticType::Object: return "Object";
+                case StaticType::Function: return "Function";
+                case StaticType::Dictionary: return "Dictionary";
+                case StaticType::Array: return "Array";
+                default: return "Unknown";
+            }
+        }
+
+        static bool isKnown(StaticType type){
+            return type != StaticType::Unknown;
+        }
+
+        static bool isOpaque(StaticType type){ //no operator accepts these
+            return type == StaticType::Null || type == StaticType::Object || type == StaticType::Function || type == StaticType::Dictionary || type == StaticType::Array;
+        }
+
+        void report(const string& message){
+            if(silent == 0){
+                throw TypeError(message);
+            }
+        }
+
+        StaticType lookup(const string& name) const{
+            if(name == "true" || name == "false"){ //declared as constants in every scope
+                return StaticType::Bool;
+            }
+            if(name == "null"){
+                return StaticType::Null;
+            }
+            if(tainted.count(name) > 0){
+                return StaticType::Unknown;
+            }
+            for(auto scope = scopes.rbegin(); scope != scopes.rend(); scope++){
+                auto variable = scope->variables.find(name);
+                if(variable != scope->variables.end()){
+                    return variable->second;
+                }
+                if(scope->functionBoundary){
+                    break;
+                }
+            }
+            return StaticType::Unknown;
+        }
+
+        void declare(const string& name, StaticType type){
+            scopes.back().variables[name] = tainted.count(name) > 0 ? StaticType::Unknown : type;
+        }
+
+        void assign(const string& name, StaticType type){
+            for(auto scope = scopes.rbegin(); scope != scopes.rend(); scope++){
+                auto variable = scope->variables.find(name);
+                if(variable != scope->variables.end()){
+                    variable->second = tainted.count(name) > 0 ? StaticType::Unknown : type;
+                    return;
+                }
+                if(scope->functionBoundary){
+                    return;
+                }
+            }
+        }
+
+        static vector<Scope> join(const vector<Scope>& left, const vector<Scope>& right){ //a variable keeps its type only if both paths agree
+            vector<Scope> result = left;
+            for(size_t i = 0; i < result.size() && i < right.size(); i++){
+                for(auto& variable : result[i].variables){
+                    auto other = right[i].variables.find(variable.first);
+                    if(other == right[i].variables.end() || other->second != variable.second){
+                        variable.second = StaticType::Unknown;
+                    }
+                }
+            }
+            return result;
+        }
+
+        void collectAssignedNames(const vector<shared_ptr<Statement>>& body){ //environment variables assigned anywhere inside a function
+            for(auto& statement : body){
+                collectAssignedNames(statement);
+            }
+        }
+
+        void collectAssignedNames(const shared_ptr<Statement>& statement){
+            if(statement == nullptr){
+                return;
+            }
+            switch(statement->node){
+                case NodeType::VariableAssignmentNode:{
+                    VariableAssignmentNode* assignmentNode = static_cast<VariableAssignmentNode*>(statement.get());
+                    if(assignmentNode->assignmentVariable->node == NodeType::IdentifierNode){
+                        IdentifierNode* identifierNode = static_cast<IdentifierNode*>(assignmentNode->assignmentVariable.get());
+                        if(identifierNode->slot < 0 && identifierNode->capture < 0){
+                            tainted.insert(identifierNode->value);
+                        }
+                    }
+                    collectAssignedNames(assignmentNode->value);
+                    break;
+                }
+                case NodeType::BinaryNode:
+                    collectAssignedNames(static_cast<BinaryNode*>(statement.get())->left);
+                    collectAssignedNames(static_cast<BinaryNode*>(statement.get())->right);
+                    break;
+                case NodeType::ConditionalNode:
+                    collectAssignedNames(static_cast<ConditionalNode*>(statement.get())->left);
+                    collectAssignedNames(static_cast<ConditionalNode*>(statement.get())->right);
+                    break;
+                case NodeType::VariableDeclarationNode:
+                    collectAssignedNames(static_cast<VariableDeclarationNode*>(statement.get())->value);
+                    break;
+                case NodeType::PrintNode:
+                    collectAssignedNames(static_cast<PrintNode*>(statement.get())->value);
+                    break;
+                case NodeType::ReturnNode:
+                    collectAssignedNames(static_cast<ReturnNode*>(statement.get())->value);
+                    break;
+                case NodeType::IfNode:
+                    collectAssignedNames(static_cast<IfNode*>(statement.get())->condition);
+                    collectAssignedNames(static_cast<IfNode*>(statement.get())->ifBody);
+                    collectAssignedNames(static_cast<IfNode*>(statement.get())->elseBody);
+                    break;
+                case NodeType::ForNode:{
+                    ForNode* forNode = static_cast<ForNode*>(statement.get());
+                    collectAssignedNames(forNode->initializer);
+                    collectAssignedNames(forNode->condition);
+                    collectAssignedNames(forNode->increment);
+                    collectAssignedNames(forNode->forBody);
+                    break;
+                }
+                case NodeType::FunctionDeclarationNode:
+                    collectAssignedNames(static_cast<FunctionDeclarationNode*>(statement.get())->body);
+                    break;
+                case NodeType::CallNode:
+                    collectAssignedNames(static_cast<CallNode*>(statement.get())->callee);
+                    for(auto& argument : static_cast<CallNode*>(statement.get())->arguments){
+                        collectAssignedNames(argument);
+                    }
+                    break;
+                case NodeType::MemberNode:
+                    collectAssignedNames(static_cast<MemberNode*>(statement.get())->object);
+                    break;
+                case NodeType::ObjectLiteralNode:
+                    for(auto& property : static_cast<ObjectLiteralNode*>(statement.get())->properties){
+                        collectAssignedNames(property.second);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        void analyzeBody(const vector<shared_ptr<Statement>>& body){
+            scopes.push_back(Scope());
+            for(auto& statement : body){
+                analyzeStatement(statement);
+            }
+            scopes.pop_back();
+        }
+
+        void analyzeIf(IfNode* ifNode){
+            analyzeExpression(ifNode->condition);
+            vector<Scope> before = scopes;
+            analyzeBody(ifNode->ifBody);
+            vector<Scope> afterIf = scopes;
+            scopes = before;
+            analyzeBody(ifNode->elseBody);
+            scopes = join(afterIf, scopes);
+        }
+
+        void analyzeLoopPass(ForNode* forNode){
+            analyzeExpression(forNode->condition);
+            analyzeBody(forNode->forBody);
+            analyzeStatement(forNode->increment);
+        }
+
+        void analyzeFor(ForNode* forNode){
+            scopes.push_back(Scope());
+            analyzeStatement(forNode->initializer);
+            vector<Scope> entry = scopes;
+            silent++;
+            while(true){ //widen the loop entry until a pass over the body does not change it
+                analyzeLoopPass(forNode);
+                vector<Scope> joined = join(entry, scopes);
+                if(joined == entry){
+                    break;
+                }
+                entry = joined;
+                scopes = entry;
+            }
+            silent--;
+            scopes = entry;
+            analyzeLoopPass(forNode); //annotates and reports from the fixed point
+            scopes = entry;
+            scopes.pop_back();
+        }
+
+        void analyzeFunction(FunctionDeclarationNode* functionNode){
+            declare(functionNode->name, StaticType::Function);
+            collectAssignedNames(functionNode->body);
+            vector<Scope> outside = scopes;
+            Scope frame;
+            frame.functionBoundary = true;
+            for(auto& parameter : functionNode->parameters){
+                frame.variables[parameter] = StaticType::Unknown;
+            }
+            scopes.push_back(frame);
+            for(auto& statement : functionNode->body){
+                analyzeStatement(statement);
+            }
+            scopes = outside;
+            for(auto& scope : scopes){ //names the function assigns are unknown from here on
+                for(auto& variable : scope.variables){
+                    if(tainted.count(variable.first) > 0){
+                        variable.second = StaticType::Unknown;
+                    }
+                }
+            }
+        }
+
+        StaticType analyzeBinary(BinaryNode* binaryNode){
+            StaticType left = analyzeExpression(binaryNode->left);
+            StaticType right = analyzeExpression(binaryNode->right);
+            binaryNode->operands = OperandTypes::Unknown;
+            if(isOpaque(left) || isOpaque(right)){
+                report("Invalid binary operator " + binaryNode->op + " for " + typeName(isOpaque(left) ? left : right) + "-Values");
+                return StaticType::Unknown;
+            }
+            if(!isKnown(left) || !isKnown(right)){
+                return StaticType::Unknown;
+            }
+            if(left == StaticType::Number && right == StaticType::Number){
+                binaryNode->operands = OperandTypes::Numbers;
+                return StaticType::Number;
+            }
+            if(left == StaticType::String && right == StaticType::String){
+                if(binaryNode->opCode != '+'){
+                    report("Invalid String binary operator " + binaryNode->op);
+                    return StaticType::Unknown;
+                }
+                binaryNode->operands = OperandTypes::Strings;
+                return StaticType::String;
+            }
+            if(left == StaticType::String || right == StaticType::String){
+                return StaticType::String;
+            }
+            report("Invalid binary operator " + binaryNode->op + " between " + typeName(left) + "-Values and " + typeName(right) + "-Values");
+            return StaticType::Unknown;
+        }
+
+        StaticType analyzeConditional(ConditionalNode* conditionalNode){
+            StaticType left = analyzeExpression(conditionalNode->left);
+            StaticType right = analyzeExpression(conditionalNode->right);
+            conditionalNode->operands = OperandTypes::Unknown;
+            if(isOpaque(left) || isOpaque(right)){
+                report("Invalid conditional operator (" + conditionalNode->conditionOperator + ") for " + typeName(isOpaque(left) ? left : right) + "-Values");
+            }else if(isKnown(left) && isKnown(right)){
+                if(left != right){
+                    report("Invalid conditional operation between " + string(typeName(left)) + "-Values and " + typeName(right) + "-Values");
+                }else if(left == StaticType::Number){
+                    conditionalNode->operands = OperandTypes::Numbers;
+                }else if(conditionalNode->opCode != '='){
+                    report("Invalid conditional operator (" + conditionalNode->conditionOperator + ") for " + typeName(left) + "-Values");
+                }
+            }
+            return StaticType::Bool;
+        }
+
+        StaticType analyzeExpression(const shared_ptr<Expression>& expression){
+            switch(expression->node){
+                case NodeType::NumberNode:
+                    return StaticType::Number;
+                case NodeType::StringNode:
+                    return StaticType::String;
+                case NodeType::IdentifierNode:
+                    return lookup(static_cast<IdentifierNode*>(expression.get())->value);
+                case NodeType::BinaryNode:
+                    return analyzeBinary(static_cast<BinaryNode*>(expression.get()));
+                case NodeType::ConditionalNode:
+                    return analyzeConditional(static_cast<ConditionalNode*>(expression.get()));
+                case NodeType::InvariantNode:
+                    return analyzeExpression(static_cast<InvariantNode*>(expression.get())->expression);
+                case NodeType::VariableAssignmentNode:{
+                    VariableAssignmentNode* assignmentNode = static_cast<VariableAssignmentNode*>(expression.get());
+                    StaticType type = analyzeExpression(assignmentNode->value);
+                    if(assignmentNode->assignmentVariable->node == NodeType::IdentifierNode){
+                        assign(static_cast<IdentifierNode*>(assignmentNode->assignmentVariable.get())->value, type);
+                    }else{
+                        analyzeExpression(assignmentNode->assignmentVariable);
+                    }
+                    return type;
+                }
+                case NodeType::ObjectLiteralNode:
+                    for(auto& property : static_cast<ObjectLiteralNode*>(expression.get())->properties){
+                        analyzeExpression(property.second);
+                    }
+                    return StaticType::Object;
+                case NodeType::DictionaryLiteralNode:
+                    for(auto& entry : static_cast<DictionaryLiteralNode*>(expression.get())->entries){
+                        analyzeExpression(entry.second);
+                    }
+                    return StaticType::Dictionary;
+                case NodeType::ArrayLiteralNode:
+                    for(auto& element : static_cast<ArrayLiteralNode*>(expression.get())->elements){
+                        StaticType type = analyzeExpression(element);
+                        if(isKnown(type) && type != StaticType::Number){
+                            report(string("Arrays hold numbers, got a ") + typeName(type) + "-Value");
+                        }
+                    }
+                    return StaticType::Array;
+                case NodeType::MemberNode:{
+                    MemberNode* memberNode = static_cast<MemberNode*>(expression.get());
+                    StaticType object = analyzeExpression(memberNode->object);
+                    if(isKnown(object) && object != StaticType::Object){
+                        report("Cannot access property '" + memberNode->property + "' of a " + typeName(object) + "-Value");
+                    }
+                    return StaticType::Unknown;
+                }
+                case NodeType::CallNode:{
+                    CallNode* callNode = static_cast<CallNode*>(expression.get());
+                    StaticType callee = analyzeExpression(callNode->callee);
+                    if(isKnown(callee) && callee != StaticType::Function){
+                        report(string("Called value is a ") + typeName(callee) + "-Value, not a function");
+                    }
+                    for(auto& argument : callNode->arguments){
+                        analyzeExpression(argument);
+                    }
+                    return StaticType::Unknown;
+                }
+                default:
+                    return StaticType::Unknown;
+            }
+        }
+
+        void analyzeStatement(const shared_ptr<Statement>& statement){
+            switch(statement->node){
+                case NodeType::ProgramNode:
+                    for(auto& child : static_cast<Program*>(statement.get())->statements){
+                        analyzeStatement(child);
+                    }
+                    break;
+                case NodeType::VariableDeclarationNode:{
+                    VariableDeclarationNode* declarationNode = static_cast<VariableDeclarationNode*>(statement.get());
+                    declare(declarationNode->name, declarationNode->value ? analyzeExpression(declarationNode->value) : StaticType::Null);
+                    break;
+                }
+                case NodeType::PrintNode:
+                    analyzeExpression(static_cast<PrintNode*>(statement.get())->value);
+                    break;
+                case NodeType::IfNode:
+                    analyzeIf(static_cast<IfNode*>(statement.get()));
+                    break;
+                case NodeType::ForNode:
+                    analyzeFor(static_cast<ForNode*>(statement.get()));
+                    break;
+                case NodeType::FunctionDeclarationNode:
+                    analyzeFunction(static_cast<FunctionDeclarationNode*>(statement.get()));
+                    break;
+                case NodeType::ReturnNode:
+                    if(static_cast<ReturnNode*>(statement.get())->value){
+                        analyzeExpression(static_cast<ReturnNode*>(statement.get())->value);
+                    }
+                    break;
+                default:
+                    analyzeExpression(static_pointer_cast<Expression>(statement));
+            }
+        }
+
+    public:
+        void analyze(const shared_ptr<Statement>& statement){ //statements of one program are analyzed in order, the state carries over between calls
+            analyzeStatement(statement);
+        }
+};
+
+
+#endif
@@ -7,11 +7,21 @@
 #include "memory"
 #include "unordered_map"
 #include "functional"
+#include "vector"
 #include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+#include <mutex>
+#include "GarbageCollector.h"
+#include "ExecutionLimits.h"
+#include "FlatTable.h"
 
 using namespace std;
 
 class Environment;
+class Interpreter;
+struct FunctionDeclarationNode;
 
 enum class ValueType{
     NullValue,
@@ -19,6 +29,11 @@ enum class ValueType{
     StringValue,
     BoolValue,
     ObjectValue,
+    NativeFunctionValue,
+    FunctionValue,
+    DictionaryValue,
+    ArrayValue,
+    FileValue,
 };
 
 struct R_Value{
@@ -28,6 +43,53 @@ struct R_Value{
     virtual void print() const = 0;
 };
 
+struct ReleaseState{ //destructors of containers running on this thread
+    vector<shared_ptr<R_Value>>* pending = nullptr; //owned by the outermost one
+    int depth = 0;
+};
+
+inline ReleaseState& releaseState(){
+    thread_local ReleaseState state;
+    return state;
+}
+
+/*
+    Called by the destructors of containers with a function that visits the values they hold.
+    Nested containers are freed right away up to releaseDepthLimit destructors deep, below that the
+    containers nobody else holds are moved to a list that the outermost destructor frees in a loop.
+    Dropping a long chain of objects thereby never takes more than that many destructor frames.
+*/
+constexpr int releaseDepthLimit = 128;
+
+template<typename Each>
+inline void releaseContents(Each each){
+    ReleaseState& state = releaseState();
+    if(state.depth >= releaseDepthLimit){
+        each([&state](shared_ptr<R_Value>& value){
+            if(value && value.use_count() == 1 && (value->type == ValueType::ObjectValue || value->type == ValueType::DictionaryValue || value->type == ValueType::FunctionValue)){
+                state.pending->push_back(move(value));
+            }
+        });
+        return;
+    }
+    vector<shared_ptr<R_Value>> pending;
+    bool outermost = state.pending == nullptr;
+    if(outermost){
+        state.pending = &pending;
+    }
+    state.depth++;
+    each([](shared_ptr<R_Value>& value){ value.reset(); });
+    if(outermost){
+        while(!pending.empty()){
+            shared_ptr<R_Value> value = move(pending.back());
+            pending.pop_back();
+            value.reset();
+        }
+        state.pending = nullptr;
+    }
+    state.depth--;
+}
+
 struct NullValue:R_Value{
     double value = 0.0;
     NullValue():R_Value(ValueType::NullValue){}
@@ -38,19 +100,35 @@ struct NullValue:R_Value{
 
 struct NumberValue:R_Value{
     double value=0;
+    int64_t integer=0; //exact value when isInteger, value always holds the double equivalent
+    bool isInteger=false;
     NumberValue():R_Value(ValueType::NumberValue){};
     NumberValue(double val):R_Value(ValueType::NumberValue),value(val){}
     void print() const override{
-        cout<<"\n NumberValue ( "<<value<<" )"; 
+        cout<<"\n NumberValue ( "<<(isInteger ? to_string(integer) : to_string(value))<<" )"; 
     }
 };
 
 struct StringValue:R_Value{
-    string value="";
+    string value=""; //text of strings that own it, read through text()
+    MemoryCharge charge;
+    bool interned = false; //one shared immutable value per distinct literal, compared by pointer
+    size_t hash = 0; //only set for interned strings
+    string_view view; //text of a view into memory that source keeps alive, like a line of a mapped file
+    shared_ptr<const void> source;
     StringValue():R_Value(ValueType::StringValue){}
-    StringValue(string val):R_Value(ValueType::StringValue),value(val){}
+    StringValue(string val):R_Value(ValueType::StringValue),value(move(val)){
+        charge.resize(sizeof(StringValue) + value.capacity());
+    }
+    StringValue(string val, size_t hash):R_Value(ValueType::StringValue),value(move(val)),interned(true),hash(hash){} //interned strings are shared by all scripts that use them and are not charged to a budget
+    StringValue(string_view text, shared_ptr<const void> source):R_Value(ValueType::StringValue),view(text),source(move(source)){
+        charge.resize(sizeof(StringValue));
+    }
+    string_view text() const{
+        return source != nullptr ? view : string_view(value);
+    }
     void print() const override{
-        cout<<"\n StringValue ( "<<value<<" )"; 
+        cout<<"\n StringValue ( "<<text()<<" )"; 
     }
 };
 
@@ -63,40 +141,359 @@ struct BoolValue:R_Value{
     }
 };
 
-struct ObjectValue:R_Value{
-    unordered_map<string, shared_ptr<R_Value>> properties;
-    ObjectValue():R_Value(ValueType::ObjectValue){}
+struct Shape{
+    unordered_map<string, int> slotIndices;
+    vector<string> propertyNames;
+    unordered_map<string, unique_ptr<Shape>> transitions;
+
+    int findSlot(const string& propertyName) const{
+        auto slot = slotIndices.find(propertyName);
+        return slot == slotIndices.end() ? -1 : slot->second;
+    }
+
+    Shape* withProperty(const string& propertyName){ //the tree is shared by all threads, it only grows under the lock and a shape never changes once it is in it
+        static mutex transitionsMutex;
+        lock_guard<mutex> lock(transitionsMutex);
+        auto transition = transitions.find(propertyName);
+        if(transition != transitions.end()){
+            return transition->second.get();
+        }
+        unique_ptr<Shape> next = make_unique<Shape>();
+        next->slotIndices = slotIndices;
+        next->propertyNames = propertyNames;
+        next->slotIndices[propertyName] = propertyNames.size();
+        next->propertyNames.push_back(propertyName);
+        Shape* result = next.get();
+        transitions[propertyName] = move(next);
+        return result;
+    }
+};
+
+inline Shape* emptyShape(){ //root of the transition tree, shapes are never freed
+    static Shape root;
+    return &root;
+}
+
+struct ObjectValue:R_Value,Traceable{
+    Shape* shape = emptyShape();
+    vector<shared_ptr<R_Value>> slots;
+    MemoryCharge charge;
+    ObjectValue():R_Value(ValueType::ObjectValue){
+        charge.resize(sizeof(ObjectValue));
+    }
+    ~ObjectValue() override{
+        releaseContents([this](auto release){
+            for(auto& slot : slots){
+                release(slot);
+            }
+        });
+    }
+    void addSlot(shared_ptr<R_Value> value){
+        slots.push_back(move(value));
+        charge.resize(sizeof(ObjectValue) + slots.capacity() * sizeof(shared_ptr<R_Value>));
+    }
+    void traceReferences(GcVisitor& visitor) const override{
+        for(auto& slot : slots){
+            visitor.visit(slot.get());
+        }
+    }
+    void clearReferences() override{
+        slots.clear();
+    }
+    shared_ptr<R_Value> getProperty(const string& propertyName) const{
+        int slot = shape->findSlot(propertyName);
+        return slot < 0 ? nullptr : slots[slot];
+    }
+    void setProperty(const string& propertyName, shared_ptr<R_Value> value){
+        int slot = shape->findSlot(propertyName);
+        if(slot >= 0){
+            slots[slot] = value;
+            return;
+        }
+        shape = shape->withProperty(propertyName);
+        addSlot(value);
+    }
     void print() const override{
         cout<<"\n ObjectValue ( ";
-        for(auto& prop : properties){
-            cout<<"\n "<<prop.first<<" : ";
-            prop.second->print();
+        for(size_t i = 0; i < slots.size(); i++){
+            cout<<"\n "<<shape->propertyNames[i]<<" : ";
+            slots[i]->print();
         }
         cout<<"\n )";
     }
     string getAllProperties(){
         string result = "";
-        for(auto& prop : properties){
-            result += prop.first + ", ";
+        for(auto& propertyName : shape->propertyNames){
+            result += propertyName + ", ";
         }
         return result;
     }
 };
 
+struct DictionaryValue:R_Value,Traceable{
+    FlatStringMap<shared_ptr<R_Value>> entries;
+    MemoryCharge charge;
+    DictionaryValue():R_Value(ValueType::DictionaryValue){
+        charge.resize(sizeof(DictionaryValue));
+    }
+    ~DictionaryValue() override{
+        releaseContents([this](auto release){
+            for(size_t i = 0; i < entries.size(); i++){
+                release(entries.valueAt(i));
+            }
+        });
+    }
+    shared_ptr<R_Value> get(const string& key, size_t hash){
+        shared_ptr<R_Value>* value = entries.find(key, hash);
+        return value == nullptr ? nullptr : *value;
+    }
+    void set(const string& key, size_t hash, shared_ptr<R_Value> value){
+        if(entries.set(key, hash, move(value))){
+            charge.resize(sizeof(DictionaryValue) + entries.memoryBytes());
+        }
+    }
+    bool remove(const string& key, size_t hash){
+        if(!entries.erase(key, hash)){
+            return false;
+        }
+        charge.resize(sizeof(DictionaryValue) + entries.memoryBytes());
+        return true;
+    }
+    void traceReferences(GcVisitor& visitor) const override{
+        for(auto& entry : entries.all()){
+            visitor.visit(entry.value.get());
+        }
+    }
+    void clearReferences() override{
+        entries.clear();
+    }
+    void print() const override{
+        cout<<"\n DictionaryValue ( ";
+        for(auto& entry : entries.all()){
+            cout<<"\n "<<entry.key<<" : ";
+            entry.value->print();
+        }
+        cout<<"\n )";
+    }
+};
 
+struct ArrayValue:R_Value{ //holds numbers unboxed, elements are read back as number values
+    vector<double> numbers;
+    MemoryCharge charge;
+    ArrayValue():R_Value(ValueType::ArrayValue){
+        charge.resize(sizeof(ArrayValue));
+    }
+    ArrayValue(vector<double> values):R_Value(ValueType::ArrayValue),numbers(move(values)){
+        charged();
+    }
+    void charged(){ //after the element storage changed
+        charge.resize(sizeof(ArrayValue) + numbers.capacity() * sizeof(double));
+    }
+    void push(double number){
+        size_t capacity = numbers.capacity();
+        numbers.push_back(number);
+        if(numbers.capacity() != capacity){
+            charged();
+        }
+    }
+    void print() const override{
+        cout<<"\n ArrayValue ( ";
+        for(double number : numbers){
+            cout<<number<<" ";
+        }
+        cout<<")";
+    }
+};
+
+inline size_t hashKey(const string& key){
+    return hash<string>()(key);
+}
+
+using NativeFunction = shared_ptr<R_Value>(*)(Interpreter& interpreter, const shared_ptr<R_Value>* arguments, size_t argumentCount);
+
+struct NativeFunctionValue:R_Value{
+    string name = "";
+    int arity = 0; //-1 accepts any number of arguments
+    NativeFunction function = nullptr;
+    NativeFunctionValue(string name, int arity, NativeFunction function):R_Value(ValueType::NativeFunctionValue),name(name),arity(arity),function(function){}
+    void print() const override{
+        cout<<"\n NativeFunctionValue ( "<<name<<" )";
+    }
+};
+
+struct FunctionValue:R_Value,Traceable{
+    string name = "";
+    shared_ptr<FunctionDeclarationNode> declaration;
+    shared_ptr<Environment> closure;
+    vector<shared_ptr<R_Value>> captures;
+    FunctionValue(string name, shared_ptr<FunctionDeclarationNode> declaration, shared_ptr<Environment> closure):R_Value(ValueType::FunctionValue),name(name),declaration(declaration),closure(closure){}
+    ~FunctionValue() override{
+        releaseContents([this](auto release){
+            for(auto& capture : captures){
+                release(capture);
+            }
+        });
+    }
+    void traceReferences(GcVisitor& visitor) const override{
+        visitor.visit(closure.get());
+        for(auto& capture : captures){
+            visitor.visit(capture.get());
+        }
+    }
+    void clearReferences() override{
+        closure = nullptr;
+        captures.clear();
+    }
+    void print() const override{
+        cout<<"\n FunctionValue ( "<<name<<" )";
+    }
+};
+
+
+
+
+inline void appendNumber(string& target, const NumberValue& number){ //shortest representation that parses back to the same number
+    char buffer[32];
+    to_chars_result converted = number.isInteger ? to_chars(buffer, buffer + sizeof(buffer), number.integer) : to_chars(buffer, buffer + sizeof(buffer), number.value);
+    target.append(buffer, converted.ptr);
+}
+
+inline string formatNumber(const NumberValue& number){
+    string text;
+    appendNumber(text, number);
+    return text;
+}
+
+inline shared_ptr<ObjectValue> makeObjectValue(){
+    shared_ptr<ObjectValue> object = make_shared<ObjectValue>();
+    garbageCollector().track(static_cast<R_Value*>(object.get()), object, object.get());
+    return object;
+}
+
+inline shared_ptr<DictionaryValue> makeDictionaryValue(){
+    shared_ptr<DictionaryValue> dictionary = make_shared<DictionaryValue>();
+    garbageCollector().track(static_cast<R_Value*>(dictionary.get()), dictionary, dictionary.get());
+    return dictionary;
+}
+
+inline shared_ptr<ArrayValue> makeArrayValue(vector<double> numbers = {}){ //arrays hold no references, the collector does not need to see them
+    return make_shared<ArrayValue>(move(numbers));
+}
 
+inline shared_ptr<FunctionValue> makeFunctionValue(string name, shared_ptr<FunctionDeclarationNode> declaration, shared_ptr<Environment> closure){
+    shared_ptr<FunctionValue> function = make_shared<FunctionValue>(name, declaration, closure);
+    garbageCollector().track(static_cast<R_Value*>(function.get()), function, function.get());
+    return function;
+}
 
-inline shared_ptr<R_Value> makeNullValue(){
-    return make_shared<NullValue>();
+inline shared_ptr<R_Value> makeNullValue(){ //null and bool values are immutable and shared
+    static const shared_ptr<R_Value> nullValue = make_shared<NullValue>();
+    return nullValue;
+}
+inline shared_ptr<R_Value> makeIntegerValue(int64_t val){
+    static const vector<shared_ptr<R_Value>> smallIntegers = [](){ //loop counters and small results are shared instead of allocated
+        vector<shared_ptr<R_Value>> integers;
+        for(int64_t i = -128; i < 1024; i++){
+            shared_ptr<NumberValue> number = make_shared<NumberValue>(double(i));
+            number->integer = i;
+            number->isInteger = true;
+            integers.push_back(number);
+        }
+        return integers;
+    }();
+    if(val >= -128 && val < 1024){
+        return smallIntegers[val + 128];
+    }
+    shared_ptr<NumberValue> number = make_shared<NumberValue>(double(val));
+    number->integer = val;
+    number->isInteger = true;
+    return number;
 }
 inline shared_ptr<R_Value> makeNumberValue(double val){
+    if(val >= -9223372036854775808.0 && val < 9223372036854775808.0 && double(int64_t(val)) == val){
+        return makeIntegerValue(int64_t(val));
+    }
     return make_shared<NumberValue>(val);  
 }
+inline shared_ptr<R_Value> parseNumberText(string_view text){ //integers stay exact like literals, null when the text is no number
+    while(!text.empty() && (text.front() == ' ' || text.front() == '\t')){
+        text.remove_prefix(1);
+    }
+    while(!text.empty() && (text.back() == ' ' || text.back() == '\t')){
+        text.remove_suffix(1);
+    }
+    if(text.size() > 1 && text.front() == '+' && text[1] != '-'){
+        text.remove_prefix(1);
+    }
+    const char* end = text.data() + text.size();
+    if(text.find_first_of(".eE") == string_view::npos){
+        int64_t integer = 0;
+        from_chars_result parsed = from_chars(text.data(), end, integer);
+        if(parsed.ec == errc() && parsed.ptr == end){
+            return makeIntegerValue(integer);
+        }
+    }
+    double number = 0;
+    from_chars_result parsed = from_chars(text.data(), end, number);
+    if(text.empty() || parsed.ec != errc() || parsed.ptr != end){
+        return nullptr;
+    }
+    return makeNumberValue(number);
+}
 inline shared_ptr<R_Value> makeStringValue(string val){
-    return make_shared<StringValue>(val); 
+    return make_shared<StringValue>(move(val)); 
+}
+inline shared_ptr<R_Value> makeStringView(string_view text, shared_ptr<const void> source){ //no copy of the text, source owns it
+    return make_shared<StringValue>(text, move(source));
 }
+class StringTable{ //holds the interned values weakly, a string no program or value uses any more is freed and its entry dropped later
+    private:
+        mutex lock;
+        unordered_map<string, weak_ptr<StringValue>> strings;
+        size_t sweepAt = 1024;
+
+        void sweep(){ //drops the entries of freed strings once the table doubled since the last sweep
+            for(auto entry = strings.begin(); entry != strings.end();){
+                entry = entry->second.expired() ? strings.erase(entry) : next(entry);
+            }
+            sweepAt = max<size_t>(1024, 2 * strings.size());
+        }
+    public:
+        shared_ptr<StringValue> intern(const string& text){
+            lock_guard<mutex> guard(lock);
+            weak_ptr<StringValue>& entry = strings[text];
+            shared_ptr<StringValue> value = entry.lock();
+            if(value != nullptr){
+                return value;
+            }
+            value = shared_ptr<StringValue>(new StringValue(text, hashKey(text))); //not make_shared, the entry would keep the memory of the value
+            entry = value;
+            if(strings.size() >= sweepAt){
+                sweep();
+            }
+            return value;
+        }
+};
+
+inline shared_ptr<StringValue> internString(const string& text){ //the table is shared by all threads, so equal literals that are alive at the same time are the same value
+    static StringTable* table = new StringTable();
+    return table->intern(text);
+}
+
+inline bool stringsEqual(const StringValue* left, const StringValue* right){
+    if(left == right){
+        return true;
+    }
+    if(left->interned && right->interned){
+        return false;
+    }
+    return left->text() == right->text();
+}
+
 inline shared_ptr<R_Value> makeBoolValue(bool val){
-    return make_shared<BoolValue>(val);
+    static const shared_ptr<R_Value> trueValue = make_shared<BoolValue>(true);
+    static const shared_ptr<R_Value> falseValue = make_shared<BoolValue>(false);
+    return val ? trueValue : falseValue;
 }
 
 
@@ -4,15 +4,113 @@
 #include "../headers/Fundament.h"
 #include "filesystem"
 
+bool readOption(const string& argument, const string& option, uint64_t& target){
+    if(argument.rfind(option, 0) != 0){
+        return false;
+    }
+    try{
+        target = stoull(argument.substr(option.size()));
+    }catch(const exception&){
+        cerr<<"\n\n[[ERROR]]: Invalid value for "<<option<<"\n\n";
+        exit(1);
+    }
+    return true;
+}
 
 int main(int argc, char* argv[]){
-    std::filesystem::path filename = argv[1];
-    if(filename.extension() != ".cael"){
+    ExecutionLimits limits;
+    string file = "";
+    vector<string> files;
+    bool streaming = false, green = false;
+    uint64_t greenThreads = 1;
+    uint64_t greenStack = greenStackBytes;
+    string loadSnapshotFile = "", writeSnapshotFile = "";
+    string daemonSocket = "", connectSocket = "";
+    uint64_t daemonWorkers = thread::hardware_concurrency();
+    vector<string> parameters;
+    bool timing = false;
+    for(int i = 1; i < argc; i++){
+        string argument = argv[i];
+        if(readOption(argument, "--max-steps=", limits.maxSteps) || readOption(argument, "--max-memory=", limits.maxMemoryBytes) || readOption(argument, "--timeout-ms=", limits.timeoutMs) || readOption(argument, "--max-depth=", limits.maxCallDepth)){
+            continue;
+        }
+        if(readOption(argument, "--green-threads=", greenThreads) || readOption(argument, "--green-stack=", greenStack)){
+            continue;
+        }
+        if(argument == "--green"){
+            green = true;
+            continue;
+        }
+        if(argument == "--stream"){
+            streaming = true;
+            continue;
+        }
+        if(argument.rfind("--snapshot=", 0) == 0){
+            loadSnapshotFile = argument.substr(11);
+            continue;
+        }
+        if(argument.rfind("--write-snapshot=", 0) == 0){
+            writeSnapshotFile = argument.substr(17);
+            continue;
+        }
+        if(readOption(argument, "--workers=", daemonWorkers)){
+            continue;
+        }
+        if(argument.rfind("--daemon=", 0) == 0){
+            daemonSocket = argument.substr(9);
+            continue;
+        }
+        if(argument.rfind("--connect=", 0) == 0){
+            connectSocket = argument.substr(10);
+            continue;
+        }
+        if(argument.rfind("--param=", 0) == 0){
+            parameters.push_back(argument.substr(8));
+            continue;
+        }
+        if(argument == "--timing"){
+            timing = true;
+            continue;
+        }
+        file = argument;
+        files.push_back(argument);
+    }
+    if(!daemonSocket.empty()){ //serves scripts sent by --connect clients until it is stopped
+        try{
+            ScriptDaemon(daemonSocket, daemonWorkers, limits).run();
+        }catch(const ScriptError& error){
+            cerr<<error.what();
+        }
+        exit(1);
+    }
+    if(!connectSocket.empty()){ //runs the script in a daemon and exits with its status
+        if(file != "-" && std::filesystem::path(file).extension() != ".cael"){
+            cerr<<"\n\n[[ERROR]]: Invalid file, expected .cael file\n\n";
+            exit(1);
+        }
+        try{
+            return runDaemonClient(connectSocket, file, limits, parameters, timing);
+        }catch(const ScriptError& error){
+            cerr<<error.what();
+            exit(1);
+        }
+    }
+    if(green){ //all given scripts run interleaved on --green-threads OS threads
+        for(auto& greenFile : files){
+            if(std::filesystem::path(greenFile).extension() != ".cael"){
+                cerr<<"\n\n[[ERROR]]: Invalid file, expected .cael file\n\n";
+                exit(1);
+            }
+        }
+        Fundament f(files, limits, greenThreads, greenStack);
+        return 0;
+    }
+    std::filesystem::path filename = file;
+    if(file != "-" && filename.extension() != ".cael"){
         cerr<<"\n\n[[ERROR]]: Invalid file, expected .cael file\n\n";
         exit(1);
     }
-    Fundament f(argv[1]);
+    Fundament f(file, limits, streaming, loadSnapshotFile, writeSnapshotFile);
 }
 
 #endif
-